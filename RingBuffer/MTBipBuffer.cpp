@@ -0,0 +1,111 @@
+//
+//  MTBipBuffer.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MTBipBuffer.hpp"
+
+//******************************************************************************
+MTBipBuffer::MTBipBuffer(int Size) :
+mSize        (Size),
+mBuffer      (new byte[Size]),
+mWrite       (0),
+mWatermark   (Size),
+mRead        (0),
+mReserveStart(0),
+mReserveSize (0) {
+    // Verify if there's enough space for the buffer
+    if (mBuffer == NULL) {
+        throw std::length_error("BipBuffer out of memory!");
+    }
+    std::memset(mBuffer, 0, mSize); // set buffer to 0
+}
+
+//******************************************************************************
+MTBipBuffer::~MTBipBuffer() {
+    // Free memory
+    delete[] mBuffer;
+    mBuffer = NULL;
+}
+
+//******************************************************************************
+// Write never catches up with read from behind, write == read always means empty.
+byte* MTBipBuffer::reserve(int size) {
+    const int write = mWrite.loadRelaxed();
+    const int read = mRead.loadAcquire();
+    
+    mReserveSize = 0;
+    if (write >= read) {
+        if (mSize - write >= size) {
+            // Fits before the end
+            mReserveStart = write;
+        } else if (read > size) {
+            // Wrap early, the tail from write on is left unused
+            mReserveStart = 0;
+        } else {
+            return NULL;
+        }
+    } else if (read - write > size) {
+        // Already wrapped, fits before the reader
+        mReserveStart = write;
+    } else {
+        return NULL;
+    }
+    mReserveSize = size;
+    return mBuffer + mReserveStart;
+}
+
+//******************************************************************************
+void MTBipBuffer::commit(int size) {
+    if ((size <= 0) || (size > mReserveSize)) {
+        mReserveSize = 0;
+        return;
+    }
+    
+    // On a wrap, the reader has to know where the data before it ends
+    const int write = mWrite.loadRelaxed();
+    if ((mReserveStart == 0) && (write != 0)) {
+        mWatermark.storeRelaxed(write);
+    }
+    
+    // The release publishes the bytes and the watermark together
+    mWrite.storeRelease(mReserveStart + size);
+    mReserveSize = 0;
+}
+
+//******************************************************************************
+const byte* MTBipBuffer::read(int* size) {
+    const int write = mWrite.loadAcquire();
+    int read = mRead.loadRelaxed();
+    
+    if (write < read) {
+        // The producer wrapped, read up to the watermark then start over
+        const int watermark = mWatermark.loadRelaxed();
+        if (read < watermark) {
+            *size = watermark - read;
+            return mBuffer + read;
+        }
+        read = 0;
+        mRead.storeRelease(read);
+    }
+    
+    *size = write - read;
+    return (*size > 0) ? mBuffer + read : NULL;
+}
+
+//******************************************************************************
+void MTBipBuffer::release(int size) {
+    // The release hands the space back to the producer after the bytes were read
+    mRead.storeRelease(mRead.loadRelaxed() + size);
+}
+
+//******************************************************************************
+int MTBipBuffer::size() const {
+    return mSize;
+}
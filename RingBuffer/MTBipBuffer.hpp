@@ -0,0 +1,85 @@
+//
+//  MTBipBuffer.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTBipBuffer_hpp
+#define MTBipBuffer_hpp
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qglobal.h>
+
+#include "MTAudioControllerGlobals.h"
+
+/*!
+ Bip-buffer: a circular buffer of bytes that always grants contiguous
+ reservations, for producers of variable size records that need to write them in
+ a single pass, e.g. an encoder.
+ 
+ When a reservation doesn't fit before the end of the buffer, it starts over at
+ the beginning and the tail left behind is marked as unused with a watermark, so
+ the reader skips it. Reads are contiguous as well.
+ 
+ One producer thread (reserve/commit) and one consumer thread (read/release) can
+ use it at the same time without locks.
+*/
+class MTBipBuffer {
+public:
+    /*!
+     The class constructor.
+     @param Size Size of the buffer in bytes.
+    */
+    explicit MTBipBuffer(int Size);
+    
+    /*! The class destructor. */
+    ~MTBipBuffer();
+    
+    /*!
+     Reserves a contiguous region to write into. Only one reservation can be
+     pending, a new one replaces it.
+     @param size Size of the region in bytes, less than the buffer size.
+     @return Start of the region, or NULL if there isn't a contiguous region of that
+     size free yet.
+    */
+    byte* reserve(int size);
+    
+    /*!
+     Publishes the start of the pending reservation to the reader.
+     @param size Number of bytes written, at most the size reserved.
+    */
+    void commit(int size);
+    
+    /*!
+     Returns the contiguous region of committed bytes waiting to be read.
+     @param size Size of the region in bytes, 0 if there is nothing to read.
+     @return Start of the region, or NULL if there is nothing to read.
+    */
+    const byte* read(int* size);
+    
+    /*!
+     Releases bytes at the start of the region returned by read.
+     @param size Number of bytes released, at most the size read.
+    */
+    void release(int size);
+    
+    /*! Returns the size of the buffer in bytes. */
+    int size() const;
+    
+private:
+    const int mSize;        // Size of mBuffer in bytes
+    byte* mBuffer;          // The buffer
+    
+    QAtomicInt mWrite;      // End of the committed bytes, written by the producer
+    QAtomicInt mWatermark;  // End of the bytes before the wrap, written by the producer
+    QAtomicInt mRead;       // Start of the bytes to read, written by the consumer
+    
+    int mReserveStart;      // Start of the pending reservation, producer only
+    int mReserveSize;       // Size of the pending reservation, producer only
+    
+    Q_DISABLE_COPY(MTBipBuffer)
+};
+
+#endif /* MTBipBuffer_hpp */
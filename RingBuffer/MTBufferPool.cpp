@@ -0,0 +1,90 @@
+//
+//  MTBufferPool.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MTBufferPool.hpp"
+
+//******************************************************************************
+MTBufferPool::MTBufferPool(int BufferSize, int NumBuffers) :
+mBufferSize(BufferSize),
+mNumBuffers(NumBuffers),
+mBuffers   (new byte[static_cast<size_t>(BufferSize) * NumBuffers]),
+mNext      (new QAtomicInt[NumBuffers]),
+mFreeHead  (NumBuffers > 0 ? 0 : NoBuffer) {
+    // Verify if there's enough space for the buffers
+    if ((mBuffers == NULL) || (mNext == NULL)) {
+        throw std::length_error("BufferPool out of memory!");
+    }
+    std::memset(mBuffers, 0, static_cast<size_t>(mBufferSize) * mNumBuffers);
+    
+    // Chain all buffers in order
+    for (int index = 0; index < mNumBuffers; index++) {
+        mNext[index].storeRelaxed(index + 1 < mNumBuffers ? index + 1 : -1);
+    }
+}
+
+//******************************************************************************
+MTBufferPool::~MTBufferPool() {
+    // Free memory
+    delete[] mBuffers;
+    delete[] mNext;
+    mBuffers = NULL;
+    mNext = NULL;
+}
+
+//******************************************************************************
+qint32 MTBufferPool::acquire() {
+    quint64 head = mFreeHead.loadAcquire();
+    while (true) {
+        const quint32 index = static_cast<quint32>(head);
+        if (index == NoBuffer) {
+            return -1;
+        }
+        
+        // The acquire makes the content written before the release visible
+        const quint64 next = nextHead(head, static_cast<quint32>(mNext[index].loadRelaxed()));
+        if (mFreeHead.testAndSetAcquire(head, next, head)) {
+            return static_cast<qint32>(index);
+        }
+    }
+}
+
+//******************************************************************************
+void MTBufferPool::release(qint32 index) {
+    quint64 head = mFreeHead.loadRelaxed();
+    while (true) {
+        mNext[index].storeRelaxed(static_cast<qint32>(static_cast<quint32>(head)));
+        
+        // The release publishes the content and the link together
+        if (mFreeHead.testAndSetRelease(head, nextHead(head, index), head)) {
+            return;
+        }
+    }
+}
+
+//******************************************************************************
+byte* MTBufferPool::buffer(qint32 index) const {
+    return mBuffers + static_cast<size_t>(mBufferSize) * index;
+}
+
+//******************************************************************************
+int MTBufferPool::bufferSize() const {
+    return mBufferSize;
+}
+
+//******************************************************************************
+int MTBufferPool::numBuffers() const {
+    return mNumBuffers;
+}
+
+//******************************************************************************
+quint64 MTBufferPool::nextHead(quint64 head, quint32 index) {
+    return (((head >> 32) + 1) << 32) | index;
+}
@@ -0,0 +1,83 @@
+//
+//  MTBufferPool.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTBufferPool_hpp
+#define MTBufferPool_hpp
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qglobal.h>
+
+#include "MTAudioControllerGlobals.h"
+
+/*!
+ Pool of NumBuffers fixed-size buffers handed around by index, for payloads too
+ large to copy through a RingBuffer, e.g. video frames.
+ 
+ A producer acquires a buffer, fills it and passes its index through a RingBuffer
+ in handle mode (insertHandleBlocking), the consumer reads the index
+ (readHandleBlocking), uses the buffer in place and releases it back to the
+ pool. Payload bytes are never copied.
+ 
+ The free buffers are kept in a lock-free stack. Its head carries a counter next
+ to the index, bumped on every change, so a stale head never wins a swap (ABA).
+ Any thread can acquire and release.
+*/
+class MTBufferPool {
+public:
+    /*!
+     The class constructor, all buffers start free.
+     @param BufferSize Size of one buffer in bytes.
+     @param NumBuffers Number of buffers.
+    */
+    MTBufferPool(int BufferSize, int NumBuffers);
+    
+    /*! The class destructor. */
+    ~MTBufferPool();
+    
+    /*!
+     Takes a free buffer out of the pool. This method never blocks.
+     @return Index of the buffer, or -1 if all buffers are in use.
+    */
+    qint32 acquire();
+    
+    /*!
+     Gives a buffer back to the pool. Its content is visible to the next thread
+     that acquires it.
+     @param index Index returned by acquire.
+    */
+    void release(qint32 index);
+    
+    /*!
+     @param index Index returned by acquire.
+     @return The buffer, BufferSize bytes.
+    */
+    byte* buffer(qint32 index) const;
+    
+    /*! Returns the size of one buffer in bytes. */
+    int bufferSize() const;
+    
+    /*! Returns the number of buffers. */
+    int numBuffers() const;
+    
+private:
+    /*! Index in the low half of mFreeHead when the stack is empty. */
+    static const quint32 NoBuffer = 0xFFFFFFFFu;
+    
+    /*! Head of the stack with its counter bumped, pointing to index. */
+    static quint64 nextHead(quint64 head, quint32 index);
+    
+    const int mBufferSize;   // Size of one buffer in bytes
+    const int mNumBuffers;   // Number of buffers
+    byte* mBuffers;          // The buffers, one after the other
+    QAtomicInt* mNext;       // Next free buffer after every free buffer
+    QAtomicInteger<quint64> mFreeHead; // Counter in the high half, first free index in the low half
+    
+    Q_DISABLE_COPY(MTBufferPool)
+};
+
+#endif /* MTBufferPool_hpp */
@@ -0,0 +1,80 @@
+//
+//  MTClockSkewEstimator.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MTClockSkewEstimator.hpp"
+
+//******************************************************************************
+MTClockSkewEstimator::MTClockSkewEstimator(int TimeConstant) :
+mWeight        (TimeConstant > 1 ? 1.0 / TimeConstant : 0.0),
+mStarted       (false),
+mRemoteOrigin  (0),
+mLocalOrigin   (0),
+mRemoteMean    (0.0),
+mLocalMean     (0.0),
+mRemoteVariance(0.0),
+mCovariance    (0.0),
+mSkew          (0) {
+    // A time constant of 1 forgets every pair at once, the variance stays 0
+    if (TimeConstant < 2) {
+        throw std::invalid_argument("Clock skew time constant is invalid!");
+    }
+}
+
+//******************************************************************************
+void MTClockSkewEstimator::update(qint64 remoteTimestamp, qint64 localArrival) {
+    // Work relative to the first pair to keep the precision of the doubles
+    if (!mStarted) {
+        mStarted = true;
+        mRemoteOrigin = remoteTimestamp;
+        mLocalOrigin = localArrival;
+    }
+    const double remote = static_cast<double>(remoteTimestamp - mRemoteOrigin);
+    const double local = static_cast<double>(localArrival - mLocalOrigin);
+    
+    // Exponentially weighted means and moments, from deltas so nothing cancels out
+    const double remoteDelta = remote - mRemoteMean;
+    const double localDelta = local - mLocalMean;
+    mRemoteMean += mWeight * remoteDelta;
+    mLocalMean += mWeight * localDelta;
+    mRemoteVariance = (1.0 - mWeight) * (mRemoteVariance + mWeight * remoteDelta * remoteDelta);
+    mCovariance = (1.0 - mWeight) * (mCovariance + mWeight * remoteDelta * localDelta);
+    
+    if (mRemoteVariance <= 0.0) {
+        return;
+    }
+    
+    // A local clock running slower sees less local time per remote time
+    const double slope = mCovariance / mRemoteVariance;
+    const double skewPpm = (1.0 / slope - 1.0) * 1e6;
+    
+    // Publish the estimate as the bits of the double
+    qint64 bits;
+    std::memcpy(&bits, &skewPpm, sizeof(bits));
+    mSkew.storeRelease(bits);
+}
+
+//******************************************************************************
+double MTClockSkewEstimator::skew() const {
+    const qint64 bits = mSkew.loadAcquire();
+    double skewPpm;
+    std::memcpy(&skewPpm, &bits, sizeof(skewPpm));
+    return skewPpm;
+}
+
+//******************************************************************************
+void MTClockSkewEstimator::reset() {
+    mStarted = false;
+    mRemoteMean = 0.0;
+    mLocalMean = 0.0;
+    mRemoteVariance = 0.0;
+    mCovariance = 0.0;
+    mSkew.storeRelease(0);
+}
@@ -0,0 +1,63 @@
+//
+//  MTClockSkewEstimator.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTClockSkewEstimator_hpp
+#define MTClockSkewEstimator_hpp
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qglobal.h>
+
+/*!
+ Estimates the skew between the clock of a remote sender and the local clock,
+ to drive resampling and latency decisions of the RingBuffer consumers.
+ 
+ Every received slot gives a pair (remote timestamp, local arrival time). The
+ local time is fit against the remote time with an exponentially weighted
+ linear regression, updated in O(1) per pair. The slope minus one is the skew.
+ 
+ update() must be called from one thread only (e.g. the one inserting the slots),
+ skew() can be called from any thread without locking.
+*/
+class MTClockSkewEstimator {
+public:
+    /*!
+     The class constructor.
+     @param TimeConstant Number of updates the regression averages over, at least 2.
+    */
+    explicit MTClockSkewEstimator(int TimeConstant);
+    
+    /*!
+     Adds one timestamped arrival to the estimate. Both times are in the same
+     unit (e.g. microseconds), their origins don't matter.
+     @param remoteTimestamp Timestamp given by the sender.
+     @param localArrival Local time the slot arrived at.
+    */
+    void update(qint64 remoteTimestamp, qint64 localArrival);
+    
+    /*!
+     Returns the current skew estimate in parts per million. It's positive when
+     the remote clock runs faster than the local one. It's lock-free.
+    */
+    double skew() const;
+    
+    /*! Clears the estimate, e.g. after the sender restarted. */
+    void reset();
+    
+private:
+    const double mWeight;      // Weight of a new pair, 1/TimeConstant
+    bool mStarted;             // True once the origins are set
+    qint64 mRemoteOrigin;      // Remote timestamp of the first pair
+    qint64 mLocalOrigin;       // Local arrival time of the first pair
+    double mRemoteMean;        // Weighted mean of the remote times
+    double mLocalMean;         // Weighted mean of the local times
+    double mRemoteVariance;    // Weighted variance of the remote times
+    double mCovariance;        // Weighted covariance of remote and local times
+    QAtomicInteger<qint64> mSkew; // Bits of the published skew in ppm (a double)
+};
+
+#endif /* MTClockSkewEstimator_hpp */
@@ -0,0 +1,86 @@
+//
+//  MTConcealment.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "MTConcealment.hpp"
+#include "MTSampleKernels.hpp"
+
+//******************************************************************************
+MTPitchConcealment::MTPitchConcealment(int MinPeriod, int MaxPeriod, int FadeSlots) :
+mMinPeriod(MinPeriod),
+mMaxPeriod(MaxPeriod),
+mFadeSlots(FadeSlots),
+mPhase    (0) {
+    if ((MinPeriod < 1) || (MaxPeriod < MinPeriod) || (FadeSlots < 1)) {
+        throw std::invalid_argument("Pitch concealment parameters are invalid!");
+    }
+    mCycle.reserve(mMaxPeriod);
+}
+
+//******************************************************************************
+void MTPitchConcealment::conceal(const byte* history, int historySize, int lostSlots,
+                                 byte* ptrToReadSlot, int slotSize) {
+    const float* samples = reinterpret_cast<const float*>(history);
+    const int numSamples = historySize / static_cast<int>(sizeof(float));
+    float* readSamples = reinterpret_cast<float*>(ptrToReadSlot);
+    const int slotSamples = slotSize / static_cast<int>(sizeof(float));
+    
+    // Past the fade there's nothing left to repeat
+    if ((lostSlots > mFadeSlots) || (numSamples < 2 * mMinPeriod)) {
+        std::memset(ptrToReadSlot, 0, slotSize);
+        return;
+    }
+    
+    // Keep the last period before the loss, so the fade doesn't compound
+    if ((lostSlots == 1) || mCycle.empty()) {
+        const int period = findPeriod(samples, numSamples);
+        mCycle.assign(samples + numSamples - period, samples + numSamples);
+        mPhase = 0;
+    }
+    
+    // Repeat the period, it continues right after the end of the history
+    const int period = static_cast<int>(mCycle.size());
+    int done = 0;
+    while (done < slotSamples) {
+        const int count = std::min(slotSamples - done, period - mPhase);
+        std::memcpy(readSamples + done, &mCycle[mPhase], count * sizeof(float));
+        mPhase = (mPhase + count) % period;
+        done += count;
+    }
+    
+    // Fade out linearly over mFadeSlots slots
+    const float startGain = 1.0f - static_cast<float>(lostSlots - 1) / mFadeSlots;
+    const float endGain = 1.0f - static_cast<float>(lostSlots) / mFadeSlots;
+    MTSampleKernels::ramp(readSamples, startGain, endGain, slotSamples);
+}
+
+//******************************************************************************
+int MTPitchConcealment::findPeriod(const float* samples, int numSamples) const {
+    // Compare the end of the history with itself, one lag earlier
+    const int maxPeriod = std::min(mMaxPeriod, numSamples / 2);
+    const int window = numSamples - maxPeriod;
+    const float* end = samples + numSamples - window;
+    const float endEnergy = MTSampleKernels::dot(end, end, window);
+    
+    int period = maxPeriod;
+    float bestScore = -2.0f;
+    for (int lag = mMinPeriod; lag <= maxPeriod; lag++) {
+        const float energy = endEnergy * MTSampleKernels::dot(end - lag, end - lag, window);
+        const float correlation = MTSampleKernels::dot(end, end - lag, window);
+        const float score = (energy > 0.0f) ? correlation / std::sqrt(energy) : 0.0f;
+        if (score > bestScore) {
+            bestScore = score;
+            period = lag;
+        }
+    }
+    return period;
+}
@@ -0,0 +1,72 @@
+//
+//  MTConcealment.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTConcealment_hpp
+#define MTConcealment_hpp
+
+#include <vector>
+
+#include "MTAudioControllerGlobals.h"
+
+/*!
+ Interface of the packet loss concealment engines used by the RingBuffer
+ when a slot of a sequence-numbered stream is missing at playout time.
+*/
+class MTConcealmentEngine {
+public:
+    /*! The class destructor. */
+    virtual ~MTConcealmentEngine() {}
+    
+    /*!
+     Fills one missing slot. It's called with the RingBuffer locked, once per
+     missing slot, and its output is appended to the history afterwards.
+     @param history Last read slots, oldest first, including concealed ones.
+     @param historySize Size of the history in bytes.
+     @param lostSlots Number of consecutive missing slots, 1 for the first one.
+     @param ptrToReadSlot Pointer to the slot to fill.
+     @param slotSize Size of one slot in bytes.
+    */
+    virtual void conceal(const byte* history, int historySize, int lostSlots,
+                         byte* ptrToReadSlot, int slotSize) = 0;
+};
+
+/*!
+ Built-in concealment for 32-bit float audio. It repeats the last pitch period
+ found in the history and fades it out over a number of missing slots.
+*/
+class MTPitchConcealment : public MTConcealmentEngine {
+public:
+    /*!
+     The class constructor.
+     @param MinPeriod Shortest pitch period searched, in samples.
+     @param MaxPeriod Longest pitch period searched, in samples. The history has
+     to hold at least twice as many samples.
+     @param FadeSlots Number of missing slots until the output is silent.
+    */
+    MTPitchConcealment(int MinPeriod, int MaxPeriod, int FadeSlots);
+    
+    virtual void conceal(const byte* history, int historySize, int lostSlots,
+                         byte* ptrToReadSlot, int slotSize);
+    
+private:
+    /*!
+     Finds the lag with the highest normalized autocorrelation at the end of the history.
+     @param samples History samples.
+     @param numSamples Number of history samples.
+     @return Pitch period in samples.
+    */
+    int findPeriod(const float* samples, int numSamples) const;
+    
+    const int mMinPeriod;      // Shortest pitch period searched
+    const int mMaxPeriod;      // Longest pitch period searched
+    const int mFadeSlots;      // Number of missing slots until silence
+    std::vector<float> mCycle; // Last pitch period before the loss
+    int mPhase;                // Position of the next output sample in mCycle
+};
+
+#endif /* MTConcealment_hpp */
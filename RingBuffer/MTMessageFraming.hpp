@@ -0,0 +1,190 @@
+//
+//  MTMessageFraming.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTMessageFraming_hpp
+#define MTMessageFraming_hpp
+
+#include <QtCore/qglobal.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "MTAudioControllerGlobals.h"
+#include "MTBipBuffer.hpp"
+
+/*!
+ Tagged messages built in place in a BipBuffer.
+ 
+ Every message is a record made of an MTMessageHeader and the message struct,
+ padded to MTMessageAlignment bytes. A message type is a struct with a unique
+ \b Tag constant, e.g.
+ 
+     struct SetGain { static const quint32 Tag = 1; float gain; };
+ 
+ The writer constructs it directly in the reserved record, so there's no
+ serialization buffer to copy from. The reader hands every record to the
+ overload of the handler for its type, picked at compile time from the list of
+ message types, so there's no copy and no virtual call per message.
+ 
+ Messages are never destroyed, so they have to be trivially destructible and
+ can't point into their own record after it's released.
+*/
+
+/*! Records start and end on this boundary, the BipBuffer storage is aligned to it. */
+static const int MTMessageAlignment = 8;
+
+/*! Header in front of every message. */
+struct MTMessageHeader {
+    quint32 tag;   // Tag of the message type
+    quint32 size;  // Size of the record, header and padding included
+};
+
+/*!
+ Producer side: constructs messages in place. Only one thread can write.
+*/
+class MTMessageWriter {
+public:
+    /*!
+     The class constructor.
+     @param Buffer BipBuffer to write to, it has to outlive the writer.
+    */
+    explicit MTMessageWriter(MTBipBuffer* Buffer) :
+    mBuffer     (Buffer),
+    mPendingSize(0) {
+    }
+    
+    /*!
+     Reserves a record and constructs a message in it. The message is published
+     by commit, after it's been filled.
+     @param args Arguments of the message constructor.
+     @return The message in the BipBuffer, or NULL if there isn't space for it yet.
+    */
+    template <typename Message, typename... Args>
+    Message* construct(Args&&... args) {
+        static_assert(std::is_trivially_destructible<Message>::value,
+                      "Messages are never destroyed");
+        static_assert(alignof(Message) <= MTMessageAlignment,
+                      "Messages can't be aligned beyond MTMessageAlignment");
+    
+        const int size = recordSize(sizeof(Message));
+        byte* record = mBuffer->reserve(size);
+        if (record == NULL) {
+            mPendingSize = 0;
+            return NULL;
+        }
+    
+        MTMessageHeader* header = new (record) MTMessageHeader;
+        header->tag = Message::Tag;
+        header->size = size;
+        mPendingSize = size;
+        return new (record + sizeof(MTMessageHeader)) Message(std::forward<Args>(args)...);
+    }
+    
+    /*! Publishes the message returned by the last construct. */
+    void commit() {
+        mBuffer->commit(mPendingSize);
+        mPendingSize = 0;
+    }
+    
+    /*!
+     Constructs a message and publishes it at once.
+     @param args Arguments of the message constructor.
+     @return False if there isn't space for it yet.
+    */
+    template <typename Message, typename... Args>
+    bool send(Args&&... args) {
+        if (construct<Message>(std::forward<Args>(args)...) == NULL) {
+            return false;
+        }
+        commit();
+        return true;
+    }
+    
+private:
+    /*! Size of the record of a message of messageSize bytes. */
+    static int recordSize(size_t messageSize) {
+        const size_t size = sizeof(MTMessageHeader) + messageSize;
+        return static_cast<int>((size + MTMessageAlignment - 1) / MTMessageAlignment * MTMessageAlignment);
+    }
+    
+    MTBipBuffer* const mBuffer; // BipBuffer to write to
+    int mPendingSize;           // Size of the record constructed and not committed
+};
+
+/*!
+ Compile-time table of message types: finds the type of a tag and calls the
+ handler overload for it. Every step is an inlined comparison, like a switch.
+*/
+template <typename... Messages>
+struct MTMessageTable;
+
+template <>
+struct MTMessageTable<> {
+    template <typename Handler>
+    static bool dispatch(quint32, const byte*, Handler&) {
+        return false;
+    }
+};
+
+template <typename First, typename... Rest>
+struct MTMessageTable<First, Rest...> {
+    template <typename Handler>
+    static bool dispatch(quint32 tag, const byte* message, Handler& handler) {
+        if (tag == First::Tag) {
+            handler(*reinterpret_cast<const First*>(message));
+            return true;
+        }
+        return MTMessageTable<Rest...>::dispatch(tag, message, handler);
+    }
+};
+
+/*!
+ Consumer side: hands the messages to a handler with one operator() overload per
+ message type, in place in the BipBuffer. Only one thread can read.
+*/
+template <typename... Messages>
+class MTMessageReader {
+public:
+    /*!
+     The class constructor.
+     @param Buffer BipBuffer to read from, it has to outlive the reader.
+    */
+    explicit MTMessageReader(MTBipBuffer* Buffer) :
+    mBuffer(Buffer) {
+    }
+    
+    /*!
+     Dispatches the messages waiting to be read, then releases their records.
+     Records with a tag that isn't in Messages are skipped.
+     @param handler Object called with a const reference to every message.
+     @return Number of messages dispatched.
+    */
+    template <typename Handler>
+    int dispatch(Handler& handler) {
+        int size;
+        const byte* records = mBuffer->read(&size);
+    
+        int dispatched = 0;
+        for (int offset = 0; offset < size; ) {
+            const MTMessageHeader* header = reinterpret_cast<const MTMessageHeader*>(records + offset);
+            if (MTMessageTable<Messages...>::dispatch(header->tag, records + offset + sizeof(MTMessageHeader), handler)) {
+                dispatched++;
+            }
+            offset += header->size;
+        }
+    
+        mBuffer->release(size);
+        return dispatched;
+    }
+    
+private:
+    MTBipBuffer* const mBuffer; // BipBuffer to read from
+};
+
+#endif /* MTMessageFraming_hpp */
@@ -0,0 +1,85 @@
+//
+//  MTPacedConsumer.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "MTPacedConsumer.hpp"
+#include "MTRingBuffer.hpp"
+
+//******************************************************************************
+MTPacedConsumer::MTPacedConsumer(MTRingBuffer* RingBuffer, int SlotSize, int PeriodUs, int SpinUs) :
+mRingBuffer(RingBuffer),
+mPeriodUs  (PeriodUs),
+mSpinUs    (SpinUs),
+mReadSlot  (new byte[SlotSize]),
+mRunning   (1) {
+    std::memset(mReadSlot, 0, SlotSize);
+    std::memset(&mStatistics, 0, sizeof(mStatistics));
+}
+
+//******************************************************************************
+MTPacedConsumer::~MTPacedConsumer() {
+    stop();
+    delete[] mReadSlot;
+    mReadSlot = NULL;
+}
+
+//******************************************************************************
+void MTPacedConsumer::stop() {
+    mRunning.storeRelease(0);
+    wait();
+}
+
+//******************************************************************************
+MTPacedConsumer::Statistics MTPacedConsumer::statistics() {
+    QMutexLocker locker(&mStatisticsMutex);
+    return mStatistics;
+}
+
+//******************************************************************************
+void MTPacedConsumer::run() {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period = std::chrono::microseconds(mPeriodUs);
+    const Clock::duration spin = std::chrono::microseconds(mSpinUs);
+    
+    Clock::time_point deadline = Clock::now() + period;
+    
+    while (mRunning.loadAcquire()) {
+        // Sleep until shortly before the deadline, the scheduler wakes us up late
+        std::this_thread::sleep_until(deadline - spin);
+        
+        // Spin the rest of the way
+        Clock::time_point now = Clock::now();
+        while (now < deadline) {
+            now = Clock::now();
+        }
+        
+        // Read and deliver the slot
+        mRingBuffer->readSlotNonBlocking(mReadSlot);
+        processSlot(mReadSlot);
+        
+        // Lateness is measured at the read, not including processSlot
+        const qint64 latenessNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count();
+        {
+            QMutexLocker locker(&mStatisticsMutex);
+            mStatistics.slots++;
+            if (latenessNs > mPeriodUs * 1000LL) {
+                mStatistics.lateSlots++;
+            }
+            if (latenessNs > mStatistics.maxLatenessNs) {
+                mStatistics.maxLatenessNs = latenessNs;
+            }
+            mStatistics.meanLatenessNs += (latenessNs - mStatistics.meanLatenessNs) / mStatistics.slots;
+        }
+        
+        // Next absolute deadline, late slots are caught up without drifting
+        deadline += period;
+    }
+}
@@ -0,0 +1,79 @@
+//
+//  MTPacedConsumer.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTPacedConsumer_hpp
+#define MTPacedConsumer_hpp
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qglobal.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qthread.h>
+
+#include "MTAudioControllerGlobals.h"
+
+class MTRingBuffer;
+
+/*!
+ Thread that reads one slot from a RingBuffer at an exact cadence, like a sound
+ card would, and hands it to processSlot().
+ 
+ Deadlines are absolute on the monotonic clock, so jitter never accumulates into
+ drift. The thread sleeps until shortly before each deadline and spins for the
+ rest, then reads with readSlotNonBlocking. Subclass it and override
+ processSlot() to consume the slots, the subclass destructor has to call stop().
+*/
+class MTPacedConsumer : public QThread {
+public:
+    /*! Lateness statistics of the delivered slots. */
+    struct Statistics {
+        quint64 slots;          // Number of slots delivered
+        quint64 lateSlots;      // Number of slots delivered more than a period late
+        qint64 maxLatenessNs;   // Largest lateness in nanoseconds
+        double meanLatenessNs;  // Mean lateness in nanoseconds
+    };
+    
+    /*!
+     The class constructor.
+     @param RingBuffer RingBuffer to read from, it has to outlive the consumer.
+     @param SlotSize Size of one slot of the RingBuffer in bytes.
+     @param PeriodUs Time between two slots in microseconds.
+     @param SpinUs Time spent spinning before each deadline in microseconds.
+    */
+    MTPacedConsumer(MTRingBuffer* RingBuffer, int SlotSize, int PeriodUs, int SpinUs);
+    
+    /*! The class destructor, stops the thread. */
+    virtual ~MTPacedConsumer();
+    
+    /*! Stops the thread and waits until it has finished. It can't be started again. */
+    void stop();
+    
+    /*! Returns a copy of the lateness statistics. */
+    Statistics statistics();
+    
+protected:
+    /*!
+     Called from the consumer thread at every deadline with the slot read.
+     @param ptrToReadSlot Pointer to the slot read from the RingBuffer.
+    */
+    virtual void processSlot(const byte* ptrToReadSlot) = 0;
+    
+    /*! Thread loop. */
+    virtual void run();
+    
+private:
+    MTRingBuffer* const mRingBuffer; // RingBuffer to read from
+    const int mPeriodUs;             // Time between two slots
+    const int mSpinUs;               // Time spent spinning before each deadline
+    byte* mReadSlot;                 // Slot handed to processSlot
+    QAtomicInt mRunning;             // 1 while the thread has to keep running
+    
+    QMutex mStatisticsMutex;         // Protects mStatistics
+    Statistics mStatistics;          // Lateness statistics
+};
+
+#endif /* MTPacedConsumer_hpp */
@@ -6,36 +6,102 @@
 //  Copyright © 2017 Zeus Group LLP. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 
 #include "MTRingBuffer.hpp"
+#include "MTConcealment.hpp"
+#include "MTSampleKernels.hpp"
 
 //******************************************************************************
-MTRingBuffer::MTRingBuffer(int SlotSize, int NumSlots) :
+MTRingBuffer::MTRingBuffer(int SlotSize, int NumSlots, int MaxWindowSize) :
 mSlotSize     (SlotSize),
 mNumSlots     (NumSlots),
 mTotalSize    (mSlotSize * mNumSlots),
+mMirrorSize   (std::max(0, std::min(MaxWindowSize, mTotalSize))),
 mReadPosition (0),
 mWritePosition(0),
 mFullSlots    (0),
-mRingBuffer   (new byte[mTotalSize]),
-mLastReadSlot (new byte[mSlotSize]) {
+mReservedSlots(0),
+mRingBuffer   (new byte[mTotalSize + mMirrorSize]),
+mLastReadSlot (new byte[mSlotSize]),
+mHistorySlots (1),
+mSlotFlags    (new quint32[mNumSlots]),
+mSlotSequence (new quint32[mNumSlots]),
+mSlotLength   (new int[mNumSlots]),
+mSlotTimestamp(new qint64[mNumSlots]),
+mSlotGroupSize(new int[mNumSlots]),
+mReadSequence (0),
+mSequenced    (false),
+mConcealment  (NULL),
+mLostSlots    (0),
+mParityGroupSize(0),
+mNumParitySlots (0),
+mParitySlots    (NULL),
+mParitySequence (NULL),
+mHistoryMode    (false),
+mReceivedSlots  (new quint64[(mNumSlots + 63) / 64]),
+mDuplicateSlots (0),
+mLateSlots      (0),
+mReadRate       (0),
+mReadTokens     (0.0),
+mReadBurst      (0.0),
+mLastRefill     (0),
+mSlotKey        (new quint64[mNumSlots]),
+mLatestState    (1),
+mLatestWriteSlot(0),
+mLatestReadSlot (2),
+mSlotVersion    (new QAtomicInt[mNumSlots]),
+mMonitorWriteSlot(0),
+mSlotReferences (new QAtomicInt[mNumSlots]),
+mCoalesceDelay  (0),
+mOpenSlotUsed   (-1),
+mOpenSlotDeadline(0),
+mWindowSize   (0),
+mHopSize      (0),
+mWindowOffset (0),
+mDelayLine    (false),
+mDelayInteger (0),
+mDelayFraction(0.0f),
+mRecoveryThreshold (0),
+mRecoveryOverlap   (0),
+mRecoveryInterval  (1),
+mReadsSinceRecovery(0),
+mSilenceLevel      (0.0f),
+mComfortNoiseLevel (0.0f),
+mSilenceTarget     (0) {
     // Verify if there's enough space to for the buffers
-    if ((mRingBuffer == NULL) || (mLastReadSlot == NULL)) {
+    if ((mRingBuffer == NULL) || (mLastReadSlot == NULL) || (mSlotFlags == NULL) ||
+        (mSlotSequence == NULL) || (mReceivedSlots == NULL) || (mSlotKey == NULL) ||
+        (mSlotVersion == NULL) || (mSlotLength == NULL) || (mSlotTimestamp == NULL) ||
+        (mSlotReferences == NULL) || (mSlotGroupSize == NULL)) {
         throw std::length_error("RingBuffer out of memory!");
     }
     // Set the buffers to zeros
-    std::memset(mRingBuffer,   0, mTotalSize); // set buffer to 0
+    std::memset(mRingBuffer,   0, mTotalSize + mMirrorSize); // set buffer to 0
     std::memset(mLastReadSlot, 0, mSlotSize);  // set buffer to 0
+    std::memset(mReceivedSlots, 0, ((mNumSlots + 63) / 64) * sizeof(quint64));
+    std::memset(mSlotTimestamp, 0, mNumSlots * sizeof(qint64));
+    std::memset(mSlotGroupSize, 0, mNumSlots * sizeof(int));
 
     // Advance write position to half of the RingBuffer
-    mWritePosition = ( (NumSlots / 2) * SlotSize ) % mTotalSize;
+    setWritePosition(( (NumSlots / 2) * SlotSize ) % mTotalSize);
     
     // Udpate Full Slots accordingly
     mFullSlots = (NumSlots / 2);
+    
+    // Number the slots so that only the slots written from now on are expected
+    // None of them was inserted, they can't be read by sequence
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotSequence[slot] = (slot < mFullSlots) ? slot : slot - mNumSlots;
+        mSlotLength[slot] = mSlotSize;
+        mSlotFlags[slot] = SlotFlagEmpty;
+    }
 }
 
 //******************************************************************************
@@ -43,28 +109,84 @@ MTRingBuffer::~MTRingBuffer() {
     // Free memory
     delete[] mRingBuffer;
     delete[] mLastReadSlot;
+    delete[] mSlotFlags;
+    delete[] mSlotSequence;
+    delete[] mSlotLength;
+    delete[] mSlotTimestamp;
+    delete[] mSlotGroupSize;
+    delete[] mParitySlots;
+    delete[] mParitySequence;
+    delete[] mReceivedSlots;
+    delete[] mSlotKey;
+    delete[] mSlotVersion;
+    delete[] mSlotReferences;
     
     // Clear to prevent using invalid memory reference
     mRingBuffer = NULL;
     mLastReadSlot = NULL;
+    mSlotFlags = NULL;
+    mSlotSequence = NULL;
+    mSlotLength = NULL;
+    mSlotTimestamp = NULL;
+    mSlotGroupSize = NULL;
+    mParitySlots = NULL;
+    mParitySequence = NULL;
+    mReceivedSlots = NULL;
+    mSlotKey = NULL;
+    mSlotVersion = NULL;
+    mSlotReferences = NULL;
 }
 
 //******************************************************************************
 void MTRingBuffer::insertSlotBlocking(const byte* ptrToSlot) {
+    const SlotMetadata metadata = { mSlotSize, 0, 0, 0 };
+    insertTaggedSlotBlocking(ptrToSlot, metadata, 0, false);
+}
+
+//******************************************************************************
+void MTRingBuffer::readSlotBlocking(byte* ptrToReadSlot) {
+    readSlotBlocking(ptrToReadSlot, NULL);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot) {
+    const SlotMetadata metadata = { mSlotSize, 0, 0, 0 };
+    insertSlotNonBlocking(ptrToSlot, metadata, false);
+}
+
+//*******************************************************************************
+void MTRingBuffer::readSlotNonBlocking(byte* ptrToReadSlot) {
+    readSlotNonBlocking(ptrToReadSlot, NULL);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotBlocking(const byte* ptrToSlot, const SlotMetadata& metadata) {
+    insertTaggedSlotBlocking(ptrToSlot, metadata, 0, true);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertTaggedSlotBlocking(const byte* ptrToSlot, const SlotMetadata& metadata, quint32 tags,
+                                            bool numbered) {
     // Lock the mutex
     QMutexLocker locker(&mMutex);
     
-    // Check if there is space available to write a slot
-    // If the Ringbuffer is full, it waits for the bufferIsNotFull condition
-    while (mFullSlots == mNumSlots) {
-        mBufferIsNotFull.wait(&mMutex);
+    // With priority lanes, plain slots go to the lowest priority one
+    if (!mLanes.empty()) {
+        const int slot = insertLaneSlot(ptrToSlot, static_cast<int>(mLanes.size()) - 1, true);
+        setSlotMetadata(slot, metadata);
+        mSlotFlags[slot] |= tags;
+        return;
     }
     
+    waitForFreeSlots(1);
+    
     // Copy mSlotSize bytes to mRingBuffer
-    std::memcpy(mRingBuffer + mWritePosition, ptrToSlot, mSlotSize);
+    copySlotIn(mWritePosition, ptrToSlot, insertSequence(metadata, numbered));
+    setSlotMetadata(mWritePosition / mSlotSize, metadata);
+    mSlotFlags[mWritePosition / mSlotSize] |= tags;
     
     // Update write position
-    mWritePosition = (mWritePosition + mSlotSize) % mTotalSize;
+    setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
     mFullSlots++; //update full slots
     
     // Wake threads waitng for bufferIsNotFull condition
@@ -72,49 +194,55 @@ void MTRingBuffer::insertSlotBlocking(const byte* ptrToSlot) {
 }
 
 //******************************************************************************
-void MTRingBuffer::readSlotBlocking(byte* ptrToReadSlot) {
+void MTRingBuffer::readSlotBlocking(byte* ptrToReadSlot, SlotMetadata* metadata) {
     // Lock the mutex
     QMutexLocker locker(&mMutex);
     
-    // Check if there are slots available to read
-    // If the Ringbuffer is empty, it waits for the bufferIsNotEmpty condition
-    while (mFullSlots == 0) {
-        mBufferIsNotEmpty.wait(&mMutex);
+    waitForFullSlots(1);
+    
+    if (!mLanes.empty()) {
+        readLaneSlot(ptrToReadSlot, metadata);
+        mBufferIsNotFull.wakeAll();
+        return;
     }
     
     // Copy mSlotSize bytes to ReadSlot
-    std::memcpy(ptrToReadSlot, mRingBuffer + mReadPosition, mSlotSize);
-    
-    // Always save memory of the last read slot
-    std::memcpy(mLastReadSlot, mRingBuffer + mReadPosition, mSlotSize);
+    copySlotOut(ptrToReadSlot, metadata);
     
-    // Update write position
-    mReadPosition = (mReadPosition + mSlotSize) % mTotalSize;
-    mFullSlots--; //update full slots
+    // Update read position
+    advanceReadPosition(1);
     
     // Wake threads waitng for bufferIsNotFull condition
     mBufferIsNotFull.wakeAll();
 }
 
 //******************************************************************************
-void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot) {
+void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot, const SlotMetadata& metadata) {
+    insertSlotNonBlocking(ptrToSlot, metadata, true);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot, const SlotMetadata& metadata, bool numbered) {
     // Lock the mutex
     QMutexLocker locker(&mMutex);
     
-    /* Check if there is space available to write a slot
-     If the Ringbuffer is full, it returns without writing anything
-     and resets the buffer
-    */
-    if (mFullSlots == mNumSlots) {
-        overflowReset();
+    // With priority lanes, plain slots go to the lowest priority one
+    if (!mLanes.empty()) {
+        const int slot = insertLaneSlot(ptrToSlot, static_cast<int>(mLanes.size()) - 1, false);
+        setSlotMetadata(slot, metadata);
+        return;
+    }
+    
+    if (!makeRoomNonBlocking()) {
         return;
     }
     
     // Copy mSlotSize bytes to mRingBuffer
-    std::memcpy(mRingBuffer + mWritePosition, ptrToSlot, mSlotSize);
+    copySlotIn(mWritePosition, ptrToSlot, insertSequence(metadata, numbered));
+    setSlotMetadata(mWritePosition / mSlotSize, metadata);
     
     // Update write position
-    mWritePosition = (mWritePosition + mSlotSize) % mTotalSize;
+    setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
     mFullSlots++; //update full slots
     
     // Wake threads waitng for bufferIsNotFull condition
@@ -122,52 +250,1679 @@ void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot) {
 }
 
 //*******************************************************************************
-void MTRingBuffer::readSlotNonBlocking(byte* ptrToReadSlot) {
+void MTRingBuffer::readSlotNonBlocking(byte* ptrToReadSlot, SlotMetadata* metadata) {
     // Lock the mutex
     QMutexLocker locker(&mMutex);
     
+    // A due open slot isn't an under-run
+    if (mFullSlots == 0) {
+        publishDueSlot();
+    }
+    
     /* 
      Check if there are slots available to read
      If the Ringbuffer is empty, it returns a buffer of zeros and rests the buffer
     */
     if (mFullSlots == 0) {
+        // The next slot of a sequenced stream is late, conceal it like a hole
+        // It isn't consumed, it's still played if it arrives before the next read
+        if (mSequenced && (mConcealment != NULL)) {
+            mConcealment->conceal(mLastReadSlot, mHistorySlots * mSlotSize, ++mLostSlots,
+                                  ptrToReadSlot, mSlotSize);
+            saveLastReadSlot(ptrToReadSlot);
+            if (metadata != NULL) {
+                const SlotMetadata concealed = { mSlotSize, SlotFlagConcealed, mReadSequence, 0 };
+                *metadata = concealed;
+            }
+            return;
+        }
+        
         // Returns a buffer of zeros if there's nothing to read
         setUnderrunReadSlot(ptrToReadSlot);
         underrunReset();
+        if (metadata != NULL) {
+            const SlotMetadata underrun = { 0, 0, mReadSequence, 0 };
+            *metadata = underrun;
+        }
+        return;
+    }
+    
+    if (!mLanes.empty()) {
+        readLaneSlot(ptrToReadSlot, metadata);
+        mBufferIsNotFull.wakeAll();
+        return;
+    }
+    
+    // Shed latency by dropping silence first, it's the cheapest
+    skipSilentSlots();
+    
+    // Above the threshold, shrink the latency by playing out slightly faster
+    // Holes go through copySlotOut to be recovered or concealed, they're never compressed
+    const int readSlot = mReadPosition / mSlotSize;
+    if ((mRecoveryThreshold > 0) && (mFullSlots > mRecoveryThreshold) && (mFullSlots >= 2) &&
+        (mSlotSequence[readSlot] == mReadSequence) &&
+        (mSlotSequence[(readSlot + 1) % mNumSlots] == mReadSequence + 1) &&
+        (++mReadsSinceRecovery >= mRecoveryInterval)) {
+        mReadsSinceRecovery = 0;
+        getSlotMetadata(readSlot, metadata);
+        readCompressedSlot(ptrToReadSlot);
+        mBufferIsNotFull.wakeAll();
         return;
     }
+    
     // Copy mSlotSize bytes to ReadSlot
-    std::memcpy(ptrToReadSlot, mRingBuffer + mReadPosition, mSlotSize);
+    copySlotOut(ptrToReadSlot, metadata);
     
-    // Always save memory of the last read slot
-    std::memcpy(mLastReadSlot, mRingBuffer + mReadPosition, mSlotSize);
+    // Update read position
+    advanceReadPosition(1);
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+int MTRingBuffer::peekMetadata(SlotMetadata* metadata, int maxSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer metadata peeks aren't available with priority lanes!");
+    }
+    
+    // Only the metadata arrays are touched, not the slots
+    const int numSlots = std::min(maxSlots, mFullSlots);
+    for (int slot = 0; slot < numSlots; slot++) {
+        getSlotMetadata((mReadPosition / mSlotSize + slot) % mNumSlots, metadata + slot);
+    }
+    return numSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::skipSlots(int numSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer skips aren't available with priority lanes!");
+    }
+    
+    advanceReadPosition(std::max(0, std::min(numSlots, mFullSlots)));
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotV(const struct iovec* vector, int count) {
+    size_t totalSize = 0;
+    for (int buffer = 0; buffer < count; buffer++) {
+        totalSize += vector[buffer].iov_len;
+    }
+    if (totalSize > static_cast<size_t>(mSlotSize)) {
+        throw std::invalid_argument("RingBuffer gathered slot doesn't fit in a slot!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    // Lanes copy slots around, so they take an assembled slot
+    if (!mLanes.empty()) {
+        std::vector<byte> slot(mSlotSize, 0);
+        byte* dest = &slot[0];
+        for (int buffer = 0; buffer < count; buffer++) {
+            std::memcpy(dest, vector[buffer].iov_base, vector[buffer].iov_len);
+            dest += vector[buffer].iov_len;
+        }
+        const SlotMetadata metadata = { static_cast<int>(totalSize), 0, 0, 0 };
+        setSlotMetadata(insertLaneSlot(&slot[0], static_cast<int>(mLanes.size()) - 1, true), metadata);
+        return;
+    }
+    
+    waitForFreeSlots(1);
+    
+    // Gather straight into mRingBuffer
+    const int length = copySlotInV(mWritePosition, vector, count, mReadSequence + mFullSlots);
+    const SlotMetadata metadata = { length, 0, 0, 0 };
+    setSlotMetadata(mWritePosition / mSlotSize, metadata);
     
     // Update write position
-    mReadPosition = (mReadPosition + mSlotSize) % mTotalSize;
-    mFullSlots--; //update full slots
+    setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+    mFullSlots++; //update full slots
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotEmpty.wakeAll();
+}
+
+//******************************************************************************
+int MTRingBuffer::readSlotV(const struct iovec* vector, int count) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    waitForFullSlots(1);
+    
+    // Scatter straight from mRingBuffer when the slot is there
+    SlotMetadata metadata;
+    int length;
+    if (mLanes.empty() &&
+        ((mSlotSequence[mReadPosition / mSlotSize] == mReadSequence) ||
+         ((mParityGroupSize > 0) && recoverSlot()))) {
+        getSlotMetadata(mReadPosition / mSlotSize, &metadata);
+        length = scatterSlot(mRingBuffer + mReadPosition, metadata.length, vector, count);
+        saveLastReadSlot(mRingBuffer + mReadPosition);
+        mLostSlots = 0;
+        advanceReadPosition(1);
+    } else {
+        // Lanes and concealed slots are assembled first
+        std::vector<byte> slot(mSlotSize);
+        if (!mLanes.empty()) {
+            readLaneSlot(&slot[0], &metadata);
+        } else {
+            copySlotOut(&slot[0], &metadata);
+            advanceReadPosition(1);
+        }
+        length = scatterSlot(&slot[0], metadata.length, vector, count);
+    }
     
     // Wake threads waitng for bufferIsNotFull condition
     mBufferIsNotFull.wakeAll();
+    return length;
 }
 
 //******************************************************************************
-void MTRingBuffer::setUnderrunReadSlot(byte* ptrToReadSlot) {
-    std::memset(ptrToReadSlot, 0, mSlotSize);
+void MTRingBuffer::insertSlotsBlocking(const byte* ptrToSlots, int numSlots) {
+    if ((numSlots < 1) || (numSlots > mNumSlots)) {
+        throw std::invalid_argument("RingBuffer group size is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer groups aren't available with priority lanes!");
+    }
+    
+    waitForFreeSlots(numSlots);
+    insertGroup(ptrToSlots, numSlots);
 }
 
 //******************************************************************************
-// Under-run happens when there's nothing to read.
-void MTRingBuffer::underrunReset() {
-    // There's nothing new to read, so we clear the whole buffer (Set the entire buffer to 0)
-    std::memset(mRingBuffer, 0, mTotalSize);
+bool MTRingBuffer::insertSlotsNonBlocking(const byte* ptrToSlots, int numSlots) {
+    if ((numSlots < 1) || (numSlots > mNumSlots)) {
+        throw std::invalid_argument("RingBuffer group size is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer groups aren't available with priority lanes!");
+    }
+    
+    // A delay line makes room by dropping the oldest slots instead
+    if ((mFullSlots + numSlots > mNumSlots) && !mDelayLine) {
+        return false;
+    }
+    waitForFreeSlots(numSlots);
+    insertGroup(ptrToSlots, numSlots);
+    return true;
 }
 
 //******************************************************************************
-// Over-flow happens when there's no space to write more slots.
-void MTRingBuffer::overflowReset() {
-    // Advance the read pointer 1/2 the ring buffer
-    mReadPosition = ( mReadPosition + ( (mNumSlots/2) * mSlotSize ) ) % mTotalSize;
-    mFullSlots -= mNumSlots/2;
+int MTRingBuffer::readSlotsBlocking(byte* ptrToReadSlots, int numSlots) {
+    if ((numSlots < 1) || (numSlots > mNumSlots)) {
+        throw std::invalid_argument("RingBuffer group size is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer groups aren't available with priority lanes!");
+    }
+    
+    // Waiting unlocks, another reader may take the group meanwhile
+    int groupSlots;
+    while (true) {
+        groupSlots = skipToGroup(numSlots);
+        if (groupSlots == 0) {
+            mBufferIsNotEmpty.wait(&mMutex);
+            continue;
+        }
+        
+        // The read rate limit may wait too
+        waitForFullSlots(groupSlots);
+        if (skipToGroup(numSlots) == groupSlots) {
+            break;
+        }
+    }
+    readGroup(ptrToReadSlots, groupSlots);
+    return groupSlots;
+}
+
+//******************************************************************************
+int MTRingBuffer::readSlotsNonBlocking(byte* ptrToReadSlots, int numSlots) {
+    if ((numSlots < 1) || (numSlots > mNumSlots)) {
+        throw std::invalid_argument("RingBuffer group size is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer groups aren't available with priority lanes!");
+    }
+    
+    const int groupSlots = skipToGroup(numSlots);
+    if (groupSlots > 0) {
+        readGroup(ptrToReadSlots, groupSlots);
+    }
+    return groupSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::insertHandleBlocking(qint32 handle, int length) {
+    if (mSlotSize != static_cast<int>(sizeof(qint32))) {
+        throw std::logic_error("RingBuffer handle mode needs slots of sizeof(qint32)!");
+    }
+    const SlotMetadata metadata = { length, 0, 0, 0 };
+    insertTaggedSlotBlocking(reinterpret_cast<const byte*>(&handle), metadata, SlotFlagHandle, false);
+}
+
+//******************************************************************************
+qint32 MTRingBuffer::readHandleBlocking(int* length) {
+    if (mSlotSize != static_cast<int>(sizeof(qint32))) {
+        throw std::logic_error("RingBuffer handle mode needs slots of sizeof(qint32)!");
+    }
+    // Skip the slots that never held a handle, their zeros aren't buffers
+    qint32 handle;
+    SlotMetadata metadata;
+    do {
+        readSlotBlocking(reinterpret_cast<byte*>(&handle), &metadata);
+    } while (!(metadata.flags & SlotFlagHandle));
+    if (length != NULL) {
+        *length = metadata.length;
+    }
+    return handle;
+}
+
+//******************************************************************************
+void MTRingBuffer::setSharedConsumers(int NumConsumers) {
+    if (NumConsumers < 0) {
+        throw std::invalid_argument("RingBuffer number of shared consumers is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer shared consumers aren't available with priority lanes!");
+    }
+    
+    // Every consumer still has to read the full slots
+    mConsumerSlots.assign(NumConsumers, 0);
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotReferences[slot].storeRelaxed(NumConsumers);
+    }
+}
+
+//******************************************************************************
+const byte* MTRingBuffer::readSharedSlotBlocking(int consumer) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer shared consumers aren't available with priority lanes!");
+    }
+    if ((consumer < 0) || (consumer >= static_cast<int>(mConsumerSlots.size()))) {
+        throw std::out_of_range("RingBuffer shared consumer doesn't exist!");
+    }
+    
+    // Check if there are slots this consumer hasn't read yet
+    // If not, it waits for the bufferIsNotEmpty condition
+    while (mConsumerSlots[consumer] >= mFullSlots) {
+        mBufferIsNotEmpty.wait(&mMutex);
+    }
+    
+    const int slot = (mReadPosition / mSlotSize + mConsumerSlots[consumer]) % mNumSlots;
+    mConsumerSlots[consumer]++;
+    return mRingBuffer + slot * mSlotSize;
+}
+
+//******************************************************************************
+void MTRingBuffer::releaseSharedSlot(const byte* ptrToSlot) {
+    // Only the last consumer of a slot takes the lock
+    const int slot = static_cast<int>((ptrToSlot - mRingBuffer) / mSlotSize);
+    if (mSlotReferences[slot].fetchAndSubOrdered(1) != 1) {
+        return;
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    // Reclaim the oldest slots released by everyone, they may be released out of order
+    int released = 0;
+    while ((released < mFullSlots) &&
+           (mSlotReferences[(mReadPosition / mSlotSize + released) % mNumSlots].loadAcquire() == 0)) {
+        released++;
+    }
+    if (released == 0) {
+        return;
+    }
+    advanceReadPosition(released);
+    for (size_t consumer = 0; consumer < mConsumerSlots.size(); consumer++) {
+        mConsumerSlots[consumer] -= released;
+    }
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::setCoalescing(int FlushDelayUs) {
+    if (FlushDelayUs < 0) {
+        throw std::invalid_argument("RingBuffer coalescing flush delay is invalid!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer coalescing isn't available with priority lanes!");
+    }
+    if (mOpenSlotUsed >= 0) {
+        publishOpenSlot();
+    }
+    
+    // The slots already full hold no messages, e.g. the prefill
+    if ((mCoalesceDelay == 0) && (FlushDelayUs > 0)) {
+        for (int slot = 0; slot < mFullSlots; slot++) {
+            mSlotLength[(mReadPosition / mSlotSize + slot) % mNumSlots] = 0;
+        }
+    }
+    mCoalesceDelay = static_cast<qint64>(FlushDelayUs) * 1000;
+    mCoalesceClock.start();
+}
+
+//******************************************************************************
+void MTRingBuffer::insertMessageBlocking(const byte* message, int length) {
+    if ((length < 1) || (length > mSlotSize - static_cast<int>(sizeof(quint16))) || (length > 0xFFFF)) {
+        throw std::invalid_argument("RingBuffer message doesn't fit in a slot!");
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (mCoalesceDelay == 0) {
+        throw std::logic_error("RingBuffer coalescing is disabled!");
+    }
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer coalescing isn't available with priority lanes!");
+    }
+    
+    // Find an open slot with space for the message
+    // Waiting for a free slot unlocks, another producer may open it meanwhile
+    const int recordSize = static_cast<int>(sizeof(quint16)) + length;
+    while (true) {
+        if (mOpenSlotUsed >= 0) {
+            if (mOpenSlotUsed + recordSize <= mSlotSize) {
+                break;
+            }
+            publishOpenSlot();
+        }
+        waitForFreeSlots(1);
+        if (mOpenSlotUsed < 0) {
+            // The slot stays odd for the monitors until it's published
+            beginSlotWrite(mWritePosition);
+            mOpenSlotUsed = 0;
+            mOpenSlotDeadline = mCoalesceClock.nsecsElapsed() + mCoalesceDelay;
+            
+            // Waiting readers have to start watching the flush deadline
+            mBufferIsNotEmpty.wakeAll();
+        }
+    }
+    
+    // Append the length and the message in place
+    byte* record = mRingBuffer + mWritePosition + mOpenSlotUsed;
+    const quint16 messageLength = static_cast<quint16>(length);
+    std::memcpy(record, &messageLength, sizeof(quint16));
+    std::memcpy(record + sizeof(quint16), message, length);
+    mOpenSlotUsed += recordSize;
+    
+    // Publish right away when not even a 1-byte message would fit anymore
+    if (mOpenSlotUsed + static_cast<int>(sizeof(quint16)) + 1 > mSlotSize) {
+        publishOpenSlot();
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::flushMessages() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer coalescing isn't available with priority lanes!");
+    }
+    if (mOpenSlotUsed >= 0) {
+        publishOpenSlot();
+    }
+}
+
+//******************************************************************************
+MTRingBuffer::MessageIterator::MessageIterator(const byte* ptrToSlot, int length) :
+mSlot  (ptrToSlot),
+mLength(length),
+mOffset(0) {
+}
+
+//******************************************************************************
+bool MTRingBuffer::MessageIterator::next(const byte** message, int* length) {
+    if (mOffset + static_cast<int>(sizeof(quint16)) > mLength) {
+        return false;
+    }
+    quint16 messageLength;
+    std::memcpy(&messageLength, mSlot + mOffset, sizeof(quint16));
+    if (mOffset + static_cast<int>(sizeof(quint16)) + messageLength > mLength) {
+        return false;
+    }
+    *message = mSlot + mOffset + sizeof(quint16);
+    *length = messageLength;
+    mOffset += static_cast<int>(sizeof(quint16)) + messageLength;
+    return true;
+}
+
+//******************************************************************************
+void MTRingBuffer::setReadWindow(int WindowSize, int HopSize) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    // The window plus the slot being written has to fit in the RingBuffer
+    if ((WindowSize <= 0) || (HopSize <= 0) || (HopSize > WindowSize) ||
+        (WindowSize + mSlotSize > mTotalSize)) {
+        throw std::invalid_argument("RingBuffer window doesn't fit in the buffer!");
+    }
+    if (WindowSize > mMirrorSize) {
+        throw std::invalid_argument("RingBuffer window is larger than the mirror allocated for it!");
+    }
+    
+    // Mirror the first WindowSize bytes past the end, the buffer itself never moves
+    std::memcpy(mRingBuffer + mTotalSize, mRingBuffer, WindowSize);
+    
+    mWindowSize = WindowSize;
+    mHopSize = HopSize;
+    mWindowOffset = 0;
+}
+
+//******************************************************************************
+const byte* MTRingBuffer::acquireWindowBlocking() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer windows aren't available with priority lanes!");
+    }
+    
+    // Wait until there's a complete window to read
+    while (!isWindowAvailable()) {
+        mBufferIsNotEmpty.wait(&mMutex);
+    }
+    
+    // The mirror makes the window contiguous even if it wraps
+    return mRingBuffer + mReadPosition + mWindowOffset;
+}
+
+//******************************************************************************
+const byte* MTRingBuffer::acquireWindowNonBlocking() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer windows aren't available with priority lanes!");
+    }
+    
+    if (!isWindowAvailable()) {
+        return NULL;
+    }
+    return mRingBuffer + mReadPosition + mWindowOffset;
+}
+
+//******************************************************************************
+void MTRingBuffer::releaseWindow() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer windows aren't available with priority lanes!");
+    }
+    
+    // There's no window to release, nothing was acquired
+    if (!isWindowAvailable()) {
+        return;
+    }
+    
+    // Advance the window and release the slots it left behind
+    mWindowOffset += mHopSize;
+    const int consumedSlots = mWindowOffset / mSlotSize;
+    mWindowOffset %= mSlotSize;
+    if (consumedSlots == 0) {
+        return;
+    }
+    
+    // Always save memory of the last read slot
+    const int lastPosition = (mReadPosition + (consumedSlots - 1) * mSlotSize) % mTotalSize;
+    saveLastReadSlot(mRingBuffer + lastPosition);
+    
+    // Update read position
+    advanceReadPosition(consumedSlots);
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::setDelayLine(double DelaySamples) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    const int numSamples = mTotalSize / static_cast<int>(sizeof(float));
+    const int slotSamples = mSlotSize / static_cast<int>(sizeof(float));
+    const int delayInteger = static_cast<int>(DelaySamples);
+    
+    // The oldest interpolation tap has to be still in the RingBuffer
+    if ((mSlotSize % sizeof(float) != 0) || (DelaySamples < 0.0) ||
+        (DelaySamples + slotSamples + 1 > numSamples)) {
+        throw std::invalid_argument("RingBuffer delay doesn't fit in the buffer!");
+    }
+    
+    mDelayLine = true;
+    mDelayInteger = delayInteger;
+    mDelayFraction = static_cast<float>(DelaySamples - delayInteger);
+}
+
+//******************************************************************************
+void MTRingBuffer::readDelayedSlot(byte* ptrToReadSlot) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer delay lines aren't available with priority lanes!");
+    }
+    
+    const float* samples = reinterpret_cast<const float*>(mRingBuffer);
+    float* readSamples = reinterpret_cast<float*>(ptrToReadSlot);
+    const int numSamples = mTotalSize / static_cast<int>(sizeof(float));
+    const int slotSamples = mSlotSize / static_cast<int>(sizeof(float));
+    const int writeSample = mWritePosition / static_cast<int>(sizeof(float));
+    
+    // Newest tap of the first sample in the slot, the older tap is one sample before it
+    int newer = (writeSample - slotSamples - mDelayInteger) % numSamples;
+    if (newer < 0) {
+        newer += numSamples;
+    }
+    
+    // Interpolate in runs where both taps are contiguous
+    int done = 0;
+    while (done < slotSamples) {
+        int count;
+        if (newer == 0) {
+            // The older tap wraps to the end of the RingBuffer
+            count = 1;
+            MTSampleKernels::interpolate(samples, samples + numSamples - 1, mDelayFraction,
+                                         readSamples + done, count);
+        } else {
+            count = std::min(slotSamples - done, numSamples - newer);
+            MTSampleKernels::interpolate(samples + newer, samples + newer - 1, mDelayFraction,
+                                         readSamples + done, count);
+        }
+        newer = (newer + count) % numSamples;
+        done += count;
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::setLatencyRecovery(int ThresholdSlots, int OverlapSamples, int Interval) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    const int slotSamples = mSlotSize / static_cast<int>(sizeof(float));
+    if ((ThresholdSlots < 0) || (ThresholdSlots >= mNumSlots) || (Interval < 1) ||
+        (OverlapSamples < 1) || (OverlapSamples > slotSamples) || (mSlotSize % sizeof(float) != 0)) {
+        throw std::invalid_argument("RingBuffer latency recovery parameters are invalid!");
+    }
+    
+    mRecoveryThreshold = ThresholdSlots;
+    mRecoveryOverlap = OverlapSamples;
+    mRecoveryInterval = Interval;
+    mReadsSinceRecovery = 0;
+}
+
+//******************************************************************************
+void MTRingBuffer::setSilenceSkipping(float SilenceLevel, float ComfortNoiseLevel, int TargetSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    if ((TargetSlots < 0) || (TargetSlots >= mNumSlots) || (SilenceLevel < 0.0f) ||
+        (ComfortNoiseLevel < SilenceLevel) || (mSlotSize % sizeof(float) != 0)) {
+        throw std::invalid_argument("RingBuffer silence skipping parameters are invalid!");
+    }
+    
+    // Compare mean squares, so there's no square root per slot
+    mSilenceLevel = SilenceLevel * SilenceLevel;
+    mComfortNoiseLevel = ComfortNoiseLevel * ComfortNoiseLevel;
+    mSilenceTarget = TargetSlots;
+}
+
+//******************************************************************************
+bool MTRingBuffer::insertSlotSequenced(const byte* ptrToSlot, quint32 sequence) {
+    const SlotMetadata metadata = { mSlotSize, 0, sequence, 0 };
+    return insertSlotSequenced(ptrToSlot, metadata);
+}
+
+//******************************************************************************
+bool MTRingBuffer::insertSlotSequenced(const byte* ptrToSlot, const SlotMetadata& metadata) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer sequenced inserts aren't available with priority lanes!");
+    }
+    const quint32 sequence = metadata.sequence;
+    
+    // The first sequenced slot goes to the write position to keep the current latency
+    if (!mSequenced) {
+        mSequenced = true;
+        renumberSlots(sequence - mFullSlots);
+    }
+    
+    // Slots behind the read position missed their playout time
+    qint32 ahead = static_cast<qint32>(sequence - mReadSequence);
+    if (ahead < 0) {
+        mLateSlots++;
+        return false;
+    }
+    
+    // A slot already received since the read position passed its space is a duplicate
+    if (ahead < mNumSlots) {
+        const int slot = (mReadPosition / mSlotSize + ahead) % mNumSlots;
+        if (mReceivedSlots[slot / 64] & (Q_UINT64_C(1) << (slot % 64))) {
+            mDuplicateSlots++;
+            return false;
+        }
+    }
+    
+    // Too far ahead, drop old slots and land in the middle of the RingBuffer
+    if (ahead >= mNumSlots) {
+        const int skippedSlots = ahead - mNumSlots / 2;
+        if (skippedSlots < mFullSlots) {
+            advanceReadPosition(skippedSlots);
+        } else {
+            // Past all the full slots, the rest of the jump is over empty space
+            const int emptySlots = skippedSlots - mFullSlots;
+            advanceReadPosition(mFullSlots);
+            mReadPosition = (mReadPosition + (emptySlots % mNumSlots) * mSlotSize) % mTotalSize;
+            mReadSequence += emptySlots;
+            setWritePosition(mReadPosition);
+        }
+        mBufferIsNotFull.wakeAll();
+        ahead -= skippedSlots;
+    }
+    
+    // Copy mSlotSize bytes to mRingBuffer at the position of its sequence number
+    const int position = (mReadPosition + ahead * mSlotSize) % mTotalSize;
+    copySlotIn(position, ptrToSlot, sequence);
+    setSlotMetadata(position / mSlotSize, metadata);
+    
+    // A slot past the write position extends the readable slots up to it
+    if (ahead >= mFullSlots) {
+        setWritePosition((position + mSlotSize) % mTotalSize);
+        mFullSlots = ahead + 1;
+    }
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+    return true;
+}
+
+//******************************************************************************
+void MTRingBuffer::setConcealmentEngine(MTConcealmentEngine* Engine, int HistorySlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    if (HistorySlots < 1) {
+        throw std::invalid_argument("RingBuffer needs at least one slot of history!");
+    }
+    
+    // Resize the history, keeping the most recent slots
+    if (HistorySlots != mHistorySlots) {
+        const int historySize = HistorySlots * mSlotSize;
+        const int keptSize = std::min(HistorySlots, mHistorySlots) * mSlotSize;
+        byte* history = new byte[historySize];
+        std::memset(history, 0, historySize);
+        std::memcpy(history + historySize - keptSize,
+                    mLastReadSlot + mHistorySlots * mSlotSize - keptSize, keptSize);
+        delete[] mLastReadSlot;
+        mLastReadSlot = history;
+        mHistorySlots = HistorySlots;
+    }
+    
+    mConcealment = Engine;
+    mLostSlots = 0;
+}
+
+//******************************************************************************
+void MTRingBuffer::setParityGroupSize(int GroupSize) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    if ((GroupSize < 2) || (GroupSize > mNumSlots)) {
+        throw std::invalid_argument("RingBuffer parity group size is invalid!");
+    }
+    
+    // Enough parity slots for every group in the RingBuffer, plus the one being filled
+    delete[] mParitySlots;
+    delete[] mParitySequence;
+    mParityGroupSize = GroupSize;
+    mNumParitySlots = mNumSlots / GroupSize + 2;
+    mParitySlots = new byte[mNumParitySlots * mSlotSize];
+    mParitySequence = new quint32[mNumParitySlots];
+    
+    // No group starts at 1, so no parity slot matches yet
+    for (int slot = 0; slot < mNumParitySlots; slot++) {
+        mParitySequence[slot] = 1;
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::insertParitySlot(const byte* ptrToSlot, quint32 firstSequence) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    if ((mParityGroupSize == 0) || (firstSequence % mParityGroupSize != 0)) {
+        return;
+    }
+    
+    const int paritySlot = (firstSequence / mParityGroupSize) % mNumParitySlots;
+    std::memcpy(mParitySlots + paritySlot * mSlotSize, ptrToSlot, mSlotSize);
+    mParitySequence[paritySlot] = firstSequence;
+}
+
+//******************************************************************************
+void MTRingBuffer::setHistoryMode(bool Enabled) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    mHistoryMode = Enabled;
+}
+
+//******************************************************************************
+bool MTRingBuffer::readSlotBySequence(quint32 sequence, byte* ptrToReadSlot) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer reads by sequence aren't available with priority lanes!");
+    }
+    
+    // Read slots live in the free space behind the read position, until it's written again
+    const qint32 offset = static_cast<qint32>(sequence - mReadSequence);
+    if ((offset < mFullSlots - mNumSlots) || (offset >= mFullSlots)) {
+        return false;
+    }
+    
+    const int slot = (mReadPosition / mSlotSize + mNumSlots + offset) % mNumSlots;
+    if ((mSlotSequence[slot] != sequence) || (mSlotFlags[slot] & SlotFlagEmpty)) {
+        return false;
+    }
+    
+    // Copy mSlotSize bytes to ReadSlot
+    std::memcpy(ptrToReadSlot, mRingBuffer + slot * mSlotSize, mSlotSize);
+    return true;
+}
+
+//******************************************************************************
+quint64 MTRingBuffer::droppedDuplicateSlots() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    return mDuplicateSlots;
+}
+
+//******************************************************************************
+quint64 MTRingBuffer::droppedLateSlots() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    return mLateSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::setReadRateLimit(qint64 BitsPerSecond, int BurstSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    
+    if ((BitsPerSecond < 0) || (BurstSlots < 1)) {
+        throw std::invalid_argument("RingBuffer read rate limit is invalid!");
+    }
+    
+    // Start with a full bucket
+    mReadRate = BitsPerSecond;
+    mReadBurst = static_cast<double>(BurstSlots) * mSlotSize * 8;
+    mReadTokens = mReadBurst;
+    mRateClock.start();
+    mLastRefill = 0;
+    
+    // Let the waiting readers pick up the new rate
+    mReadRateChanged.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::setPriorityLanes(const int* LaneSlots, int NumLanes) {
+    if ((LaneSlots == NULL) || (NumLanes < 1)) {
+        throw std::invalid_argument("RingBuffer priority lanes don't fit in the buffer!");
+    }
+    int totalSlots = 0;
+    for (int lane = 0; lane < NumLanes; lane++) {
+        if (LaneSlots[lane] < 1) {
+            throw std::invalid_argument("RingBuffer priority lane is empty!");
+        }
+        if (LaneSlots[lane] > mNumSlots - totalSlots) {
+            throw std::invalid_argument("RingBuffer priority lanes don't fit in the buffer!");
+        }
+        totalSlots += LaneSlots[lane];
+    }
+    
+    // Lanes are laid out one after the other in the RingBuffer
+    std::vector<Lane> lanes(NumLanes);
+    int firstSlot = 0;
+    for (int lane = 0; lane < NumLanes; lane++) {
+        lanes[lane].firstSlot = firstSlot;
+        lanes[lane].numSlots = LaneSlots[lane];
+        lanes[lane].readSlot = 0;
+        lanes[lane].fullSlots = 0;
+        firstSlot += LaneSlots[lane];
+    }
+    
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (mCoalesceDelay > 0) {
+        throw std::logic_error("RingBuffer priority lanes aren't available while coalescing!");
+    }
+    
+    // Start with all the lanes empty, nothing received and no key pending
+    mLanes.swap(lanes);
+    mReadPosition = 0;
+    setWritePosition(0);
+    mFullSlots = 0;
+    std::memset(mReceivedSlots, 0, ((mNumSlots + 63) / 64) * sizeof(quint64));
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotFlags[slot] &= ~SlotFlagKeyed;
+    }
+    mPendingKeys.clear();
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotBlocking(const byte* ptrToSlot, int lane) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    const SlotMetadata metadata = { mSlotSize, 0, 0, 0 };
+    setSlotMetadata(insertLaneSlot(ptrToSlot, lane, true), metadata);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotNonBlocking(const byte* ptrToSlot, int lane) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    const SlotMetadata metadata = { mSlotSize, 0, 0, 0 };
+    setSlotMetadata(insertLaneSlot(ptrToSlot, lane, false), metadata);
+}
+
+//******************************************************************************
+void MTRingBuffer::insertSlotConflated(const byte* ptrToSlot, quint64 key) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer conflation isn't available with priority lanes!");
+    }
+    
+    // Overwrite the pending slot with the same key, it keeps its place in the queue
+    const int pendingSlot = mPendingKeys.value(key, -1);
+    if (pendingSlot >= 0) {
+        copySlotIn(pendingSlot * mSlotSize, ptrToSlot, mSlotSequence[pendingSlot]);
+        mSlotFlags[pendingSlot] |= SlotFlagKeyed;
+        return;
+    }
+    
+    // A new key needs a new slot, the same way as insertSlotNonBlocking
+    if (!makeRoomNonBlocking()) {
+        return;
+    }
+    
+    // Copy mSlotSize bytes to mRingBuffer
+    const int slot = mWritePosition / mSlotSize;
+    copySlotIn(mWritePosition, ptrToSlot, mReadSequence + mFullSlots);
+    mSlotFlags[slot] |= SlotFlagKeyed;
+    mSlotKey[slot] = key;
+    mPendingKeys.insert(key, slot);
+    
+    // Update write position
+    setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+    mFullSlots++; //update full slots
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::publishLatestSlot(const byte* ptrToSlot) {
+    if (mNumSlots < 3) {
+        throw std::length_error("RingBuffer latest mode needs three slots!");
+    }
+    
+    // Fill the private slot, then swap it with the shared one
+    std::memcpy(mRingBuffer + mLatestWriteSlot * mSlotSize, ptrToSlot, mSlotSize);
+    const int previous = mLatestState.fetchAndStoreOrdered(mLatestWriteSlot | LatestFresh);
+    mLatestWriteSlot = previous & ~LatestFresh;
+}
+
+//******************************************************************************
+bool MTRingBuffer::readLatestSlot(byte* ptrToReadSlot) {
+    if (mNumSlots < 3) {
+        throw std::length_error("RingBuffer latest mode needs three slots!");
+    }
+    
+    // Take the shared slot only if there's something new in it
+    const bool fresh = (mLatestState.loadAcquire() & LatestFresh) != 0;
+    if (fresh) {
+        const int previous = mLatestState.fetchAndStoreOrdered(mLatestReadSlot);
+        mLatestReadSlot = previous & ~LatestFresh;
+    }
+    
+    // Copy mSlotSize bytes to ReadSlot
+    std::memcpy(ptrToReadSlot, mRingBuffer + mLatestReadSlot * mSlotSize, mSlotSize);
+    return fresh;
+}
+
+//******************************************************************************
+int MTRingBuffer::copyRecentSlots(byte* dest, int numSlots) {
+    return copySlots(mMonitorWriteSlot.loadAcquire() - numSlots, numSlots, dest);
+}
+
+//******************************************************************************
+int MTRingBuffer::copySlots(int firstSlot, int numSlots, byte* dest) {
+    if ((numSlots < 0) || (numSlots > mNumSlots)) {
+        throw std::out_of_range("RingBuffer monitor range is invalid!");
+    }
+    
+    int skipped = 0;
+    for (int copied = 0; copied < numSlots; copied++) {
+        const int slot = (((firstSlot + copied) % mNumSlots) + mNumSlots) % mNumSlots;
+        byte* slotDest = dest + copied * mSlotSize;
+        bool complete = false;
+        for (int attempt = 0; (attempt < MonitorRetries) && !complete; attempt++) {
+            // Wait for a complete slot, copy it and check nobody wrote it meanwhile
+            const int version = mSlotVersion[slot].loadAcquire();
+            if (version & 1) {
+                continue;
+            }
+            std::memcpy(slotDest, mRingBuffer + slot * mSlotSize, mSlotSize);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            complete = (mSlotVersion[slot].loadRelaxed() == version);
+        }
+        
+        // A slot held open by a writer isn't waited for
+        if (!complete) {
+            std::memset(slotDest, 0, mSlotSize);
+            skipped++;
+        }
+    }
+    return skipped;
+}
+
+//******************************************************************************
+int MTRingBuffer::getReadableRegion(MTSpan<const byte>& first, MTSpan<const byte>& second) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer regions aren't available with priority lanes!");
+    }
+    
+    // Split where the full slots wrap around the end
+    const int firstSlots = std::min(mFullSlots, (mTotalSize - mReadPosition) / mSlotSize);
+    first = MTSpan<const byte>(mRingBuffer + mReadPosition, firstSlots * mSlotSize);
+    second = MTSpan<const byte>(mRingBuffer, (mFullSlots - firstSlots) * mSlotSize);
+    return mFullSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::consume(int numSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer regions aren't available with priority lanes!");
+    }
+    
+    advanceReadPosition(std::max(0, std::min(numSlots, mFullSlots)));
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+int MTRingBuffer::getWritableRegion(MTSpan<byte>& first, MTSpan<byte>& second) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer regions aren't available with priority lanes!");
+    }
+    
+    // Split where the free slots wrap around the end
+    const int freeSlots = mNumSlots - mFullSlots;
+    const int firstSlots = std::min(freeSlots, (mTotalSize - mWritePosition) / mSlotSize);
+    first = MTSpan<byte>(mRingBuffer + mWritePosition, firstSlots * mSlotSize);
+    second = MTSpan<byte>(mRingBuffer, (freeSlots - firstSlots) * mSlotSize);
+    return freeSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::produce(int numSlots) {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer regions aren't available with priority lanes!");
+    }
+    
+    // The slots are already in place, only their bookkeeping is left
+    numSlots = std::max(0, std::min(numSlots, mNumSlots - mFullSlots));
+    for (int slot = 0; slot < numSlots; slot++) {
+        beginSlotWrite(mWritePosition);
+        finishSlotWrite(mWritePosition, mReadSequence + mFullSlots);
+        
+        // Update write position
+        setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+        mFullSlots++; //update full slots
+    }
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+}
+
+//******************************************************************************
+byte* MTRingBuffer::reserveSlot() {
+    // Lock the mutex
+    QMutexLocker locker(&mMutex);
+    if (!mLanes.empty()) {
+        throw std::logic_error("RingBuffer reservations aren't available with priority lanes!");
+    }
+    
+    // Reserved slots take space like full slots
+    while (mFullSlots + mReservedSlots == mNumSlots) {
+        mBufferIsNotFull.wait(&mMutex);
+    }
+    
+    // The slot stays odd for the monitors until it's published
+    const int position = (mWritePosition + mReservedSlots * mSlotSize) % mTotalSize;
+    beginSlotWrite(position);
+    mSlotFlags[position / mSlotSize] = SlotFlagReserved;
+    mReservedSlots++;
+    return mRingBuffer + position;
+}
+
+//******************************************************************************
+void MTRingBuffer::commitSlot(byte* ptrToSlot) {
+    // Lock the mutex, it also publishes the filled slot to the reader
+    QMutexLocker locker(&mMutex);
+    mSlotFlags[(ptrToSlot - mRingBuffer) / mSlotSize] &= ~SlotFlagReserved;
+    
+    // Publish the committed prefix of the reservations
+    bool published = false;
+    while ((mReservedSlots > 0) && !(mSlotFlags[mWritePosition / mSlotSize] & SlotFlagReserved)) {
+        finishSlotWrite(mWritePosition, mReadSequence + mFullSlots);
+        
+        // Update write position
+        setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+        mFullSlots++; //update full slots
+        mReservedSlots--;
+        published = true;
+    }
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    if (published) {
+        mBufferIsNotEmpty.wakeAll();
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::setUnderrunReadSlot(byte* ptrToReadSlot) {
+    std::memset(ptrToReadSlot, 0, mSlotSize);
+}
+
+//******************************************************************************
+// Under-run happens when there's nothing to read.
+void MTRingBuffer::underrunReset() {
+    // The read slots are kept for readSlotBySequence
+    // Reserved slots are being filled outside of the lock, the open slot in place
+    if (mHistoryMode || (mReservedSlots > 0) || (mOpenSlotUsed >= 0)) {
+        return;
+    }
+    
+    // There's nothing new to read, so we clear the whole buffer (Set the entire buffer to 0)
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotVersion[slot].fetchAndAddOrdered(1);
+    }
+    std::memset(mRingBuffer, 0, mTotalSize + mWindowSize);
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotVersion[slot].fetchAndAddRelease(1);
+    }
+    
+    // The cleared slots don't hold their sequence numbers anymore
+    const int readSlot = mReadPosition / mSlotSize;
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        mSlotSequence[(readSlot + slot) % mNumSlots] = mReadSequence + slot - mNumSlots;
+        mSlotFlags[slot] = SlotFlagEmpty;
+    }
+}
+
+//******************************************************************************
+// Over-flow happens when there's no space to write more slots.
+void MTRingBuffer::overflowReset() {
+    // Advance the read pointer 1/2 the ring buffer
+    advanceReadPosition(mNumSlots/2);
+    mWindowOffset = 0;
+}
+
+//******************************************************************************
+void MTRingBuffer::copySlotIn(int position, const byte* ptrToSlot, quint32 sequence) {
+    beginSlotWrite(position);
+    std::memcpy(mRingBuffer + position, ptrToSlot, mSlotSize);
+    finishSlotWrite(position, sequence);
+}
+
+//******************************************************************************
+// Slots never straddle the end of mRingBuffer, only the window mirror needs care.
+int MTRingBuffer::copySlotInV(int position, const struct iovec* vector, int count, quint32 sequence) {
+    beginSlotWrite(position);
+    byte* dest = mRingBuffer + position;
+    for (int buffer = 0; buffer < count; buffer++) {
+        std::memcpy(dest, vector[buffer].iov_base, vector[buffer].iov_len);
+        dest += vector[buffer].iov_len;
+    }
+    const int length = static_cast<int>(dest - (mRingBuffer + position));
+    std::memset(dest, 0, mSlotSize - length);
+    finishSlotWrite(position, sequence);
+    return length;
+}
+
+//******************************************************************************
+int MTRingBuffer::scatterSlot(const byte* ptrToSlot, int length, const struct iovec* vector, int count) {
+    int copied = 0;
+    for (int buffer = 0; (buffer < count) && (copied < length); buffer++) {
+        const int size = static_cast<int>(std::min(vector[buffer].iov_len, static_cast<size_t>(length - copied)));
+        std::memcpy(vector[buffer].iov_base, ptrToSlot + copied, size);
+        copied += size;
+    }
+    return copied;
+}
+
+//******************************************************************************
+quint32 MTRingBuffer::insertSequence(const SlotMetadata& metadata, bool numbered) {
+    // Sequenced inserts place the slots by number instead
+    if (numbered && mHistoryMode && !mSequenced && (metadata.sequence != mReadSequence + mFullSlots)) {
+        renumberSlots(metadata.sequence - mFullSlots);
+    }
+    return mReadSequence + mFullSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::renumberSlots(quint32 readSequence) {
+    mReadSequence = readSequence;
+    const int readSlot = mReadPosition / mSlotSize;
+    for (int slot = 0; slot < mNumSlots; slot++) {
+        const int index = (readSlot + slot) % mNumSlots;
+        if (slot < mFullSlots) {
+            mSlotSequence[index] = mReadSequence + slot;
+        } else {
+            mSlotSequence[index] = mReadSequence + slot - mNumSlots;
+            mSlotFlags[index] |= SlotFlagEmpty;
+        }
+    }
+}
+
+//******************************************************************************
+bool MTRingBuffer::makeRoomNonBlocking() {
+    /* Check if there is space available to write a slot
+     If the Ringbuffer is full, it returns without writing anything
+     and resets the buffer
+    */
+    if (mFullSlots == mNumSlots) {
+        skipSilentSlots();
+    }
+    if (mFullSlots == mNumSlots) {
+        if (!mDelayLine) {
+            overflowReset();
+            return false;
+        }
+        dropOldestSlot();
+    }
+    return true;
+}
+
+//******************************************************************************
+void MTRingBuffer::waitForFreeSlots(int numSlots) {
+    // Check if there is space available to write the slots
+    // If the Ringbuffer is full, it waits for the bufferIsNotFull condition
+    // A delay line never waits, it overwrites the oldest slots instead
+    while ((mFullSlots + numSlots > mNumSlots) && !mDelayLine) {
+        mBufferIsNotFull.wait(&mMutex);
+    }
+    while (mFullSlots + numSlots > mNumSlots) {
+        dropOldestSlot();
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::waitForFullSlots(int numSlots) {
+    // Check if there are slots available to read
+    // If the Ringbuffer is empty, it waits for the bufferIsNotEmpty condition
+    // With a rate limit, it also waits until there are tokens for the slots
+    // While coalescing, it publishes the open slot when it's due
+    bool waited = false;
+    while (true) {
+        while (mFullSlots < numSlots) {
+            if (mOpenSlotUsed > 0) {
+                const qint64 remaining = mOpenSlotDeadline - mCoalesceClock.nsecsElapsed();
+                if (remaining <= 0) {
+                    publishOpenSlot();
+                } else {
+                    mBufferIsNotEmpty.wait(&mMutex, static_cast<unsigned long>((remaining + 999999) / 1000000));
+                }
+                continue;
+            }
+            mBufferIsNotEmpty.wait(&mMutex);
+            waited = false;
+        }
+        const qint64 waitTime = takeReadTokens(numSlots, waited);
+        if (waitTime == 0) {
+            break;
+        }
+        
+        // A millisecond timeout would overshoot slots much shorter than that
+        QDeadlineTimer deadline(Qt::PreciseTimer);
+        deadline.setPreciseRemainingTime(0, waitTime, Qt::PreciseTimer);
+        mReadRateChanged.wait(&mMutex, deadline);
+        waited = true;
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::publishOpenSlot() {
+    // Clear the unused tail, the metadata length tells where the messages end
+    std::memset(mRingBuffer + mWritePosition + mOpenSlotUsed, 0, mSlotSize - mOpenSlotUsed);
+    finishSlotWrite(mWritePosition, mReadSequence + mFullSlots);
+    const SlotMetadata metadata = { mOpenSlotUsed, 0, 0, 0 };
+    setSlotMetadata(mWritePosition / mSlotSize, metadata);
+    mOpenSlotUsed = -1;
+    
+    // Update write position
+    setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+    mFullSlots++; //update full slots
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::publishDueSlot() {
+    if ((mOpenSlotUsed > 0) && (mCoalesceClock.nsecsElapsed() >= mOpenSlotDeadline)) {
+        publishOpenSlot();
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::insertGroup(const byte* ptrToSlots, int numSlots) {
+    // The lock is held all along, so the group is published in one step
+    // Its first slot records where it ends
+    const int firstSlot = mWritePosition / mSlotSize;
+    for (int slot = 0; slot < numSlots; slot++) {
+        copySlotIn(mWritePosition, ptrToSlots + slot * mSlotSize, mReadSequence + mFullSlots);
+        setWritePosition((mWritePosition + mSlotSize) % mTotalSize);
+        mFullSlots++; //update full slots
+    }
+    mSlotFlags[firstSlot] |= SlotFlagGroup;
+    mSlotGroupSize[firstSlot] = numSlots;
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+}
+
+//******************************************************************************
+void MTRingBuffer::readGroup(byte* ptrToReadSlots, int numSlots) {
+    for (int slot = 0; slot < numSlots; slot++) {
+        copySlotOut(ptrToReadSlots + slot * mSlotSize, NULL);
+        advanceReadPosition(1);
+    }
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    mBufferIsNotFull.wakeAll();
+}
+
+//******************************************************************************
+int MTRingBuffer::skipToGroup(int maxSlots) {
+    // Groups are published whole and only lose slots from their start, e.g. to an
+    // overflow, so a first slot that's still there means the whole group is
+    int skippedSlots = 0;
+    int groupSlots = 0;
+    while (mFullSlots - skippedSlots > 0) {
+        const int slot = (mReadPosition / mSlotSize + skippedSlots) % mNumSlots;
+        if ((mSlotFlags[slot] & SlotFlagGroup) && (mSlotGroupSize[slot] <= mFullSlots - skippedSlots)) {
+            groupSlots = mSlotGroupSize[slot];
+            break;
+        }
+        skippedSlots++;
+    }
+    
+    // Nobody reads the skipped slots, give their space back
+    if (skippedSlots > 0) {
+        advanceReadPosition(skippedSlots);
+        mBufferIsNotFull.wakeAll();
+    }
+    
+    // The group stays for a reader with more room
+    if (groupSlots > maxSlots) {
+        throw std::length_error("RingBuffer group doesn't fit in the read buffer!");
+    }
+    return groupSlots;
+}
+
+//******************************************************************************
+void MTRingBuffer::beginSlotWrite(int position) {
+    // Odd while the slot changes, the full barrier keeps the copy after it
+    mSlotVersion[position / mSlotSize].fetchAndAddOrdered(1);
+}
+
+//******************************************************************************
+void MTRingBuffer::setWritePosition(int position) {
+    mWritePosition = position;
+    mMonitorWriteSlot.storeRelease(position / mSlotSize);
+}
+
+//******************************************************************************
+void MTRingBuffer::finishSlotWrite(int position, quint32 sequence) {
+    const int slot = position / mSlotSize;
+    
+    // Even again, the slot is complete
+    mSlotVersion[slot].fetchAndAddRelease(1);
+    mSlotFlags[slot] = classifySlot(mRingBuffer + position);
+    mSlotSequence[slot] = sequence;
+    mSlotLength[slot] = mSlotSize;
+    mSlotTimestamp[slot] = 0;
+    mSlotReferences[slot].storeRelaxed(static_cast<int>(mConsumerSlots.size()));
+    mReceivedSlots[slot / 64] |= Q_UINT64_C(1) << (slot % 64);
+    
+    // Mirror the start of the buffer past its end so windows never wrap
+    if (position < mWindowSize) {
+        const int mirrorSize = std::min(mSlotSize, mWindowSize - position);
+        std::memcpy(mRingBuffer + mTotalSize + position, mRingBuffer + position, mirrorSize);
+    }
+}
+
+//******************************************************************************
+// Only one slot of the group is missing: it's the XOR of the parity with the others.
+bool MTRingBuffer::recoverSlot() {
+    const quint32 firstSequence = mReadSequence - mReadSequence % mParityGroupSize;
+    const int paritySlot = (firstSequence / mParityGroupSize) % mNumParitySlots;
+    if (mParitySequence[paritySlot] != firstSequence) {
+        return false;
+    }
+    
+    // All the other data slots of the group have to be in the RingBuffer
+    const int readSlot = mReadPosition / mSlotSize;
+    for (int member = 0; member < mParityGroupSize; member++) {
+        const quint32 sequence = firstSequence + member;
+        const int slot = (readSlot + mNumSlots + static_cast<qint32>(sequence - mReadSequence)) % mNumSlots;
+        if ((sequence != mReadSequence) && (mSlotSequence[slot] != sequence)) {
+            return false;
+        }
+    }
+    
+    // Rebuild the slot in place
+    byte* missing = mRingBuffer + mReadPosition;
+    beginSlotWrite(mReadPosition);
+    std::memcpy(missing, mParitySlots + paritySlot * mSlotSize, mSlotSize);
+    for (int member = 0; member < mParityGroupSize; member++) {
+        const quint32 sequence = firstSequence + member;
+        const int slot = (readSlot + mNumSlots + static_cast<qint32>(sequence - mReadSequence)) % mNumSlots;
+        if (sequence != mReadSequence) {
+            MTSampleKernels::xorBytes(missing, mRingBuffer + slot * mSlotSize, mSlotSize);
+        }
+    }
+    finishSlotWrite(mReadPosition, mReadSequence);
+    return true;
+}
+
+//******************************************************************************
+void MTRingBuffer::copySlotOut(byte* ptrToReadSlot, SlotMetadata* metadata) {
+    if ((mSlotSequence[mReadPosition / mSlotSize] == mReadSequence) ||
+        ((mParityGroupSize > 0) && recoverSlot())) {
+        std::memcpy(ptrToReadSlot, mRingBuffer + mReadPosition, mSlotSize);
+        getSlotMetadata(mReadPosition / mSlotSize, metadata);
+        mLostSlots = 0;
+    } else {
+        if (mConcealment != NULL) {
+            // The slot never arrived, conceal it from what was played before
+            mConcealment->conceal(mLastReadSlot, mHistorySlots * mSlotSize, ++mLostSlots,
+                                  ptrToReadSlot, mSlotSize);
+        } else {
+            setUnderrunReadSlot(ptrToReadSlot);
+        }
+        if (metadata != NULL) {
+            const SlotMetadata concealed = { mSlotSize, SlotFlagConcealed, mReadSequence, 0 };
+            *metadata = concealed;
+        }
+    }
+    
+    // Always save memory of the last read slot
+    saveLastReadSlot(ptrToReadSlot);
+}
+
+//******************************************************************************
+void MTRingBuffer::setSlotMetadata(int slot, const SlotMetadata& metadata) {
+    if (slot < 0) {
+        return;
+    }
+    
+    // The tags under SlotFlagUser belong to the RingBuffer
+    mSlotLength[slot] = metadata.length;
+    mSlotTimestamp[slot] = metadata.timestamp;
+    mSlotFlags[slot] = (mSlotFlags[slot] & (SlotFlagUser - 1)) | (metadata.flags & ~(SlotFlagUser - 1));
+}
+
+//******************************************************************************
+void MTRingBuffer::getSlotMetadata(int slot, SlotMetadata* metadata) const {
+    if (metadata == NULL) {
+        return;
+    }
+    metadata->length = mSlotLength[slot];
+    metadata->flags = mSlotFlags[slot];
+    metadata->sequence = mSlotSequence[slot];
+    metadata->timestamp = mSlotTimestamp[slot];
+}
+
+//******************************************************************************
+void MTRingBuffer::saveLastReadSlot(const byte* ptrToSlot) {
+    const int historySize = mHistorySlots * mSlotSize;
+    std::memmove(mLastReadSlot, mLastReadSlot + mSlotSize, historySize - mSlotSize);
+    std::memcpy(mLastReadSlot + historySize - mSlotSize, ptrToSlot, mSlotSize);
+}
+
+//******************************************************************************
+void MTRingBuffer::advanceReadPosition(int numSlots) {
+    // The space of the passed slots can receive the next lap
+    for (int passed = 0; passed < numSlots; passed++) {
+        const int slot = (mReadPosition / mSlotSize + passed) % mNumSlots;
+        mReceivedSlots[slot / 64] &= ~(Q_UINT64_C(1) << (slot % 64));
+        
+        // The key of a read slot isn't pending anymore
+        if (mSlotFlags[slot] & SlotFlagKeyed) {
+            mPendingKeys.remove(mSlotKey[slot]);
+            mSlotFlags[slot] &= ~SlotFlagKeyed;
+        }
+    }
+    mReadPosition = (mReadPosition + numSlots * mSlotSize) % mTotalSize;
+    mReadSequence += numSlots;
+    mFullSlots -= numSlots;
+}
+
+//******************************************************************************
+// Removes exactly one slot worth of samples: the output starts like the first
+// slot and ends like the second one, so it's continuous with both neighbours.
+void MTRingBuffer::readCompressedSlot(byte* ptrToReadSlot) {
+    const int slotSamples = mSlotSize / static_cast<int>(sizeof(float));
+    const int overlap = mRecoveryOverlap;
+    const float* first = reinterpret_cast<const float*>(mRingBuffer + mReadPosition);
+    const float* second = reinterpret_cast<const float*>(mRingBuffer +
+                                                         (mReadPosition + mSlotSize) % mTotalSize);
+    float* readSamples = reinterpret_cast<float*>(ptrToReadSlot);
+    
+    // Search the splice point where both slots are most alike, in a bounded number of steps
+    const int searchStep = std::max(1, overlap / 4);
+    int splice = 0;
+    float bestScore = -2.0f;
+    for (int candidate = 0; candidate + overlap <= slotSamples; candidate += searchStep) {
+        const float energy = MTSampleKernels::dot(first + candidate, first + candidate, overlap) *
+                             MTSampleKernels::dot(second + candidate, second + candidate, overlap);
+        const float correlation = MTSampleKernels::dot(first + candidate, second + candidate, overlap);
+        const float score = (energy > 0.0f) ? correlation / std::sqrt(energy) : 1.0f;
+        if (score > bestScore) {
+            bestScore = score;
+            splice = candidate;
+        }
+    }
+    
+    // Head of the first slot, cross-fade, tail of the second slot
+    std::memcpy(readSamples, first, splice * sizeof(float));
+    MTSampleKernels::crossfade(first + splice, second + splice, readSamples + splice, overlap);
+    std::memcpy(readSamples + splice + overlap, second + splice + overlap,
+                (slotSamples - splice - overlap) * sizeof(float));
+    
+    // Always save memory of the last read slot
+    saveLastReadSlot(ptrToReadSlot);
+    mLostSlots = 0;
+    
+    // Update read position
+    advanceReadPosition(2);
+}
+
+//******************************************************************************
+quint32 MTRingBuffer::classifySlot(const byte* ptrToSlot) const {
+    if (mSilenceTarget == 0) {
+        return 0;
+    }
+    
+    const int slotSamples = mSlotSize / static_cast<int>(sizeof(float));
+    const float* samples = reinterpret_cast<const float*>(ptrToSlot);
+    const float meanSquare = MTSampleKernels::dot(samples, samples, slotSamples) / slotSamples;
+    
+    if (meanSquare <= mSilenceLevel) {
+        return SlotFlagSilence;
+    }
+    if (meanSquare <= mComfortNoiseLevel) {
+        return SlotFlagComfortNoise;
+    }
+    return 0;
+}
+
+//******************************************************************************
+int MTRingBuffer::insertLaneSlot(const byte* ptrToSlot, int lane, bool blocking) {
+    if ((lane < 0) || (lane >= static_cast<int>(mLanes.size()))) {
+        throw std::out_of_range("RingBuffer priority lane doesn't exist!");
+    }
+    Lane& target = mLanes[lane];
+    
+    // A full lane waits for its own space or resets like the whole buffer would
+    while (blocking && (target.fullSlots == target.numSlots)) {
+        mBufferIsNotFull.wait(&mMutex);
+    }
+    if (target.fullSlots == target.numSlots) {
+        const int droppedSlots = std::max(1, target.numSlots / 2);
+        target.readSlot = (target.readSlot + droppedSlots) % target.numSlots;
+        target.fullSlots -= droppedSlots;
+        mFullSlots -= droppedSlots;
+        return -1;
+    }
+    
+    // Copy mSlotSize bytes to the write position of the lane
+    const int writeSlot = target.firstSlot + (target.readSlot + target.fullSlots) % target.numSlots;
+    copySlotIn(writeSlot * mSlotSize, ptrToSlot, 0);
+    target.fullSlots++;
+    mFullSlots++; //update full slots
+    
+    // Wake threads waitng for bufferIsNotEmpty condition
+    mBufferIsNotEmpty.wakeAll();
+    return writeSlot;
+}
+
+//******************************************************************************
+void MTRingBuffer::readLaneSlot(byte* ptrToReadSlot, SlotMetadata* metadata) {
+    for (size_t lane = 0; lane < mLanes.size(); lane++) {
+        Lane& source = mLanes[lane];
+        if (source.fullSlots == 0) {
+            continue;
+        }
+        
+        // Copy mSlotSize bytes to ReadSlot
+        const byte* slot = mRingBuffer + (source.firstSlot + source.readSlot) * mSlotSize;
+        std::memcpy(ptrToReadSlot, slot, mSlotSize);
+        getSlotMetadata(source.firstSlot + source.readSlot, metadata);
+        saveLastReadSlot(slot);
+        
+        // Update read position
+        source.readSlot = (source.readSlot + 1) % source.numSlots;
+        source.fullSlots--;
+        mFullSlots--; //update full slots
+        return;
+    }
+    
+    // Every full slot has to belong to a lane
+    throw std::logic_error("RingBuffer full slots are outside the priority lanes!");
+}
+
+//******************************************************************************
+qint64 MTRingBuffer::takeReadTokens(int numSlots, bool waited) {
+    if (mReadRate == 0) {
+        return 0;
+    }
+    
+    // Refill the bucket with the bits earned since the last refill
+    // Idle time fills it up to the burst, but the bits earned while a reader slept
+    // for them are all kept, or oversleeping would lower the rate
+    const qint64 now = mRateClock.nsecsElapsed();
+    const double earnedBits = (now - mLastRefill) * 1e-9 * mReadRate;
+    if (waited) {
+        mReadTokens += earnedBits;
+    } else {
+        mReadTokens = std::max(mReadTokens, std::min(mReadBurst, mReadTokens + earnedBits));
+    }
+    mLastRefill = now;
+    
+    // A group larger than the burst waits for a full bucket and goes into debt
+    const double slotBits = static_cast<double>(mSlotSize) * 8 * numSlots;
+    const double neededBits = std::min(slotBits, mReadBurst);
+    if (mReadTokens >= neededBits) {
+        mReadTokens -= slotBits;
+        return 0;
+    }
+    
+    // Wait just long enough to earn the missing bits
+    return std::max<qint64>(1, static_cast<qint64>(std::ceil((neededBits - mReadTokens) * 1e9 / mReadRate)));
+}
+
+//******************************************************************************
+void MTRingBuffer::skipSilentSlots() {
+    if (mSilenceTarget == 0) {
+        return;
+    }
+    
+    bool skipped = false;
+    while ((mFullSlots > mSilenceTarget) &&
+           (mSlotFlags[mReadPosition / mSlotSize] & (SlotFlagSilence | SlotFlagComfortNoise))) {
+        advanceReadPosition(1);
+        skipped = true;
+    }
+    
+    // Wake threads waitng for bufferIsNotFull condition
+    if (skipped) {
+        mBufferIsNotFull.wakeAll();
+    }
+}
+
+//******************************************************************************
+void MTRingBuffer::dropOldestSlot() {
+    advanceReadPosition(1);
+}
+
+//******************************************************************************
+bool MTRingBuffer::isWindowAvailable() const {
+    return (mFullSlots * mSlotSize - mWindowOffset) >= mWindowSize;
 }
 
 //******************************************************************************
@@ -9,10 +9,30 @@
 #ifndef MTRingBuffer_hpp
 #define MTRingBuffer_hpp
 
+#include <QtCore/qatomic.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qglobal.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qmutex.h>
 #include <QtCore/qwaitcondition.h>
 
+#include <vector>
+
+#ifdef Q_OS_WIN
+/*! Same layout as the POSIX iovec, for scatter/gather on Windows. */
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
 #include "MTAudioControllerGlobals.h"
+#include "MTSpan.hpp"
+
+class MTConcealmentEngine;
 
 /*!
  Provides a ring-buffer (or circular-buffer) that can be written to and read from
@@ -24,12 +44,65 @@
 */
 class MTRingBuffer {
 public:
+    /*! Tags kept for every slot in the RingBuffer. */
+    enum SlotFlag {
+        SlotFlagSilence      = 0x01, // Slot level is below the silence level
+        SlotFlagComfortNoise = 0x02, // Slot level is below the comfort noise level
+        SlotFlagKeyed        = 0x04, // Slot was inserted with a conflation key
+        SlotFlagConcealed    = 0x08, // Slot was missing and concealed (reads only)
+        SlotFlagReserved     = 0x10, // Slot is reserved and still being filled
+        SlotFlagHandle       = 0x20, // Slot holds a handle from insertHandleBlocking
+        SlotFlagGroup        = 0x40, // Slot is the first of a group from insertSlotsBlocking
+        SlotFlagEmpty        = 0x80, // Slot holds zeros that were never inserted
+        SlotFlagUser         = 0x100 // First flag free for the callers, up to bit 31
+    };
+    
+    /*!
+     Metadata kept for every slot in arrays parallel to the slots, so it can be
+     scanned without touching the slot memory.
+    */
+    struct SlotMetadata {
+        int length;        // Number of bytes used in the slot
+        quint32 flags;     // SlotFlag tags and the caller flags from SlotFlagUser up
+        quint32 sequence;  // Sequence number of the slot
+        qint64 timestamp;  // Timestamp given by the caller
+    };
+    
+    /*!
+     Walks the messages packed into a slot by insertMessageBlocking, in insertion
+     order, in place in the slot read.
+    */
+    class MessageIterator {
+    public:
+        /*!
+         @param ptrToSlot Slot read from the RingBuffer.
+         @param length Metadata length of the slot.
+        */
+        MessageIterator(const byte* ptrToSlot, int length);
+        
+        /*!
+         Steps to the next message.
+         @param message Start of the message in the slot.
+         @param length Length of the message in bytes.
+         @return False when there are no more messages, or the next one runs past the
+         end of the slot.
+        */
+        bool next(const byte** message, int* length);
+        
+    private:
+        const byte* mSlot; // Slot read from the RingBuffer
+        int mLength;       // Number of bytes used in the slot
+        int mOffset;       // Offset of the next message header
+    };
+    
     /*!
      The class constructor.
      @param SlotSize Size of one slot in bytes.
      @param NumSlots Number of slots.
+     @param MaxWindowSize Largest window setReadWindow accepts, in bytes. The
+     mirror it needs is allocated here, 0 if windowed reads aren't used.
     */
-    MTRingBuffer(int SlotSize, int NumSlots);
+    MTRingBuffer(int SlotSize, int NumSlots, int MaxWindowSize = 0);
     
     /*! The class destructor. */
     virtual ~MTRingBuffer();
@@ -70,6 +143,543 @@ public:
     */
     void readSlotNonBlocking(byte* ptrToReadSlot);
     
+    /*!
+     Same as insertSlotBlocking, the metadata is written with the slot under the
+     same lock. The flags under SlotFlagUser are ignored.
+     
+     The sequence number is assigned by the RingBuffer, except in history mode
+     where the slot keeps metadata.sequence, e.g. the packet number of a sender,
+     for readSlotBySequence. The numbers are expected to be consecutive: a jump
+     numbers the slots waiting to be read again before the slot and makes the read
+     slots unreadable by sequence.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param metadata Length, caller flags, timestamp and, in history mode, sequence
+     number of the slot.
+    */
+    void insertSlotBlocking(const byte* ptrToSlot, const SlotMetadata& metadata);
+    
+    /*!
+     Same as readSlotBlocking, the metadata of the slot is read with it under the
+     same lock.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @param metadata Metadata of the slot read, or NULL.
+    */
+    void readSlotBlocking(byte* ptrToReadSlot, SlotMetadata* metadata);
+    
+    /*!
+     Same as insertSlotNonBlocking, with the metadata of the slot, numbered like
+     insertSlotBlocking with metadata.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param metadata Length, caller flags, timestamp and, in history mode, sequence
+     number of the slot.
+    */
+    void insertSlotNonBlocking(const byte* ptrToSlot, const SlotMetadata& metadata);
+    
+    /*!
+     Same as readSlotNonBlocking, with the metadata of the slot. An under-run
+     reads a length of 0.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @param metadata Metadata of the slot read, or NULL.
+    */
+    void readSlotNonBlocking(byte* ptrToReadSlot, SlotMetadata* metadata);
+    
+    /*!
+     Copy the metadata of the slots waiting to be read, oldest first, without the
+     slots themselves, e.g. to decide what to drop, skip or reorder. It isn't
+     available with priority lanes.
+     @param metadata Destination of up to maxSlots entries.
+     @param maxSlots Maximum number of entries to copy.
+     @return Number of entries copied.
+    */
+    int peekMetadata(SlotMetadata* metadata, int maxSlots);
+    
+    /*!
+     Drops the oldest slots waiting to be read without copying them. It isn't
+     available with priority lanes.
+     @param numSlots Number of slots to drop, at most the number of full slots.
+    */
+    void skipSlots(int numSlots);
+    
+    /*!
+     Same as insertSlotBlocking, but the slot is gathered from several buffers,
+     e.g. a header, a payload and a trailer, with a single copy into the slot.
+     The rest of the slot is filled with zeros and the metadata length is the
+     number of bytes gathered.
+     @param vector Buffers to gather, in order.
+     @param count Number of buffers, their total size must fit in one slot.
+    */
+    void insertSlotV(const struct iovec* vector, int count);
+    
+    /*!
+     Same as readSlotBlocking, but the slot is scattered into several buffers with
+     a single copy out of the slot.
+     @param vector Buffers to fill, in order.
+     @param count Number of buffers.
+     @return Number of bytes scattered, at most the metadata length of the slot.
+    */
+    int readSlotV(const struct iovec* vector, int count);
+    
+    /*!
+     Insert a group of consecutive slots, e.g. the slots of one frame, that become
+     readable together: readers never see only part of the group. If there isn't
+     space for the whole group, it waits for the bufferIsNotFull condition.
+     @param ptrToSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots in the group, at most NumSlots.
+    */
+    void insertSlotsBlocking(const byte* ptrToSlots, int numSlots);
+    
+    /*!
+     Same as insertSlotsBlocking, but returns without writing anything if there
+     isn't space for the whole group.
+     @param ptrToSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots in the group, at most NumSlots.
+     @return False if the group didn't fit.
+    */
+    bool insertSlotsNonBlocking(const byte* ptrToSlots, int numSlots);
+    
+    /*!
+     Read the next group inserted with insertSlotsBlocking or insertSlotsNonBlocking,
+     whole. Slots that aren't part of a complete group are dropped on the way, e.g.
+     the zero slots the RingBuffer is created with, slots inserted one by one and
+     groups cut by an overflow or skipSlots. If there's no group, it waits for the
+     bufferIsNotEmpty condition.
+     @param ptrToReadSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots ptrToReadSlots can hold, at most NumSlots. A
+     larger group throws std::length_error and is left in the RingBuffer.
+     @return Number of slots of the group read.
+    */
+    int readSlotsBlocking(byte* ptrToReadSlots, int numSlots);
+    
+    /*!
+     Same as readSlotsBlocking, but returns without reading anything if there's no
+     group yet. This isn't an under-run.
+     @param ptrToReadSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots ptrToReadSlots can hold, at most NumSlots.
+     @return Number of slots of the group read, 0 if there's no group yet.
+    */
+    int readSlotsNonBlocking(byte* ptrToReadSlots, int numSlots);
+    
+    /*!
+     Handle mode: insert the index of a buffer of an MTBufferPool instead of the
+     payload itself, so large payloads change hands without being copied. The
+     RingBuffer has to be built with a SlotSize of sizeof(qint32). If the
+     RingBuffer is full, it waits for the bufferIsNotFull condition.
+     @param handle Index of the buffer in the pool, owned by the reader from now on.
+     @param length Number of bytes used in the buffer, kept as the slot length.
+    */
+    void insertHandleBlocking(qint32 handle, int length);
+    
+    /*!
+     Handle mode: read the index of a buffer inserted with insertHandleBlocking.
+     The reader releases the buffer to its pool when it's done with it. If the
+     RingBuffer is empty, it waits for the bufferIsNotEmpty condition.
+     
+     Slots that don't hold a handle, i.e. the zero slots a new RingBuffer starts
+     with and concealed gaps, are read and skipped, so every index returned was
+     inserted and is released exactly once.
+     @param length Number of bytes used in the buffer, or NULL.
+     @return Index of the buffer in the pool.
+    */
+    qint32 readHandleBlocking(int* length);
+    
+    /*!
+     Enables the shared mode, where every slot is read by all NumConsumers
+     consumers in place, e.g. to fan a packet out without copying it into one
+     RingBuffer per consumer. Every slot carries an atomic reference count set to
+     NumConsumers when it's written, and its space is reclaimed only once all the
+     consumers released it.
+     
+     The consumers read with readSharedSlotBlocking and releaseSharedSlot only, and
+     the producers use the blocking inserts, which wait for the slowest consumer.
+     All consumers start at the oldest full slot.
+     @param NumConsumers Number of consumers, 0 to disable the shared mode.
+    */
+    void setSharedConsumers(int NumConsumers);
+    
+    /*!
+     Shared mode: returns the next slot of a consumer in place. If the consumer
+     read all the full slots, it waits for the bufferIsNotEmpty condition.
+     @param consumer Index of the consumer, from 0 to NumConsumers - 1.
+     @return Pointer to the slot, valid until the consumer releases it.
+    */
+    const byte* readSharedSlotBlocking(int consumer);
+    
+    /*!
+     Shared mode: a consumer is done with a slot. The last release of the oldest
+     slots gives their space back to the producers.
+     @param ptrToSlot Pointer returned by readSharedSlotBlocking.
+    */
+    void releaseSharedSlot(const byte* ptrToSlot);
+    
+    /*!
+     Enables coalescing, where small messages are packed into one slot instead of
+     paying the lock, copy and wake-up of a slot each, e.g. for 16 to 64 byte
+     control messages.
+     
+     insertMessageBlocking appends the messages to an open slot, in place, which is
+     published when the next message doesn't fit or FlushDelayUs after its first
+     message: readers waiting for a slot publish it themselves once it's due.
+     Every message takes 2 more bytes for its length. While coalescing, slots are
+     inserted with insertMessageBlocking only. Readers walk the messages of a slot
+     with MessageIterator. Enabling it empties the slots already full, e.g. the
+     prefill, so they're read as slots without messages. It isn't available with
+     priority lanes.
+     @param FlushDelayUs Longest time a message waits in the open slot in
+     microseconds, 0 to disable coalescing.
+    */
+    void setCoalescing(int FlushDelayUs);
+    
+    /*!
+     Coalescing mode: appends a message to the open slot. If the RingBuffer is full
+     when a new slot has to be opened, it waits for the bufferIsNotFull condition.
+     @param message Pointer to the message.
+     @param length Length of the message in bytes, at most SlotSize - 2.
+    */
+    void insertMessageBlocking(const byte* message, int length);
+    
+    /*! Coalescing mode: publishes the open slot now, if there is one. */
+    void flushMessages();
+    
+    /*!
+     Enables overlapping windowed reads of \b WindowSize bytes that advance by
+     \b HopSize bytes, e.g. 2048 samples with a 512 samples hop for FFT processing.
+     
+     The first WindowSize bytes of the RingBuffer are mirrored past its end, so
+     every window is a contiguous view into the RingBuffer itself and no data is
+     ever shifted. The mirror is allocated by the constructor, so the RingBuffer
+     never moves and the pointers handed out stay valid. Windowed reads replace
+     the slot reads, don't mix them.
+     @param WindowSize Size of one window in bytes, at most the MaxWindowSize
+     given to the constructor.
+     @param HopSize Number of bytes the window advances on releaseWindow().
+    */
+    void setReadWindow(int WindowSize, int HopSize);
+    
+    /*!
+     Returns a pointer to the next WindowSize contiguous bytes of the RingBuffer.
+     This method will block until there's a complete window in the buffer.
+     
+     The view stays valid until releaseWindow() is called.
+     @return Pointer to the first byte of the window.
+    */
+    const byte* acquireWindowBlocking();
+    
+    /*!
+     Same as acquireWindowBlocking but non-blocking (asynchronous)
+     @return Pointer to the first byte of the window or NULL if there's no complete window.
+    */
+    const byte* acquireWindowNonBlocking();
+    
+    /*!
+     Releases the window returned by acquireWindow and advances it by HopSize bytes.
+     Slots that are completely behind the next window are given back to the writers.
+     It does nothing while there's no complete window.
+    */
+    void releaseWindow();
+    
+    /*!
+     Turns the RingBuffer into a fixed delay line of 32-bit float samples.
+     
+     In this mode writes never block nor reset the buffer, the oldest slot is
+     overwritten instead, and readDelayedSlot() always returns the samples exactly
+     \b DelaySamples behind the write head, regardless of the producer timing.
+     Fractional delays are linearly interpolated. For a delay of D slots pass
+     D * SlotSize / sizeof(float).
+     @param DelaySamples Delay behind the write head in samples.
+    */
+    void setDelayLine(double DelaySamples);
+    
+    /*!
+     Read the slot that was written DelaySamples ago into ptrToReadSlot. This method
+     never blocks and doesn't consume anything from the RingBuffer.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+    */
+    void readDelayedSlot(byte* ptrToReadSlot);
+    
+    /*!
+     Enables smooth latency recovery for 32-bit float audio in readSlotNonBlocking.
+     
+     While more than \b ThresholdSlots slots are full, every \b Interval reads two
+     slots are compressed into one with an overlap-add splice (WSOLA-like): the
+     splice point is searched where both slots are most alike and they are
+     cross-faded over \b OverlapSamples samples. Playback then runs 1/Interval
+     faster until the latency is back under the threshold, with no discontinuity,
+     instead of the half buffer jump of an overflow. Slots missing from the
+     sequence are never compressed, they're recovered or concealed as usual. Pass 0
+     as ThresholdSlots to disable it.
+     @param ThresholdSlots Fill level in slots above which latency is recovered.
+     @param OverlapSamples Length of the cross-fade in samples.
+     @param Interval Number of reads per compressed slot, at least 1.
+    */
+    void setLatencyRecovery(int ThresholdSlots, int OverlapSamples, int Interval);
+    
+    /*!
+     Enables silence skipping for 32-bit float audio.
+     
+     Every inserted slot gets its RMS level measured and is tagged as silence or
+     comfort noise when it's under the given levels. While more than
+     \b TargetSlots slots are full, readSlotNonBlocking drops tagged slots at the
+     head of the RingBuffer before reading, and insertSlotNonBlocking drops them
+     before falling back to an overflow reset. Pass 0 as TargetSlots to disable it.
+     @param SilenceLevel RMS level under which a slot is silence.
+     @param ComfortNoiseLevel RMS level under which a slot is comfort noise.
+     @param TargetSlots Fill level in slots to shed the latency down to.
+    */
+    void setSilenceSkipping(float SilenceLevel, float ComfortNoiseLevel, int TargetSlots);
+    
+    /*!
+     Insert a slot of a sequence-numbered stream at the position of its sequence
+     number. This method never blocks.
+     
+     Slots can arrive out of order, the holes they leave are detected at playout
+     time and filled by the concealment engine. The first sequenced slot keeps
+     the current latency. A slot too far ahead drops old slots to make space,
+     like an overflow. Sequence numbers wrap around at 2^32, don't mix with
+     insertSlotBlocking/insertSlotNonBlocking.
+     
+     Duplicates and slots that arrive after their playout time are dropped before
+     anything is copied, duplicates are found in a bitmap of the received slots.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param sequence Sequence number of the slot.
+     @return False if the slot was a duplicate or late and was dropped.
+    */
+    bool insertSlotSequenced(const byte* ptrToSlot, quint32 sequence);
+    
+    /*!
+     Same as insertSlotSequenced, with the metadata of the slot.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param metadata Length, sequence number, caller flags and timestamp of the slot.
+     @return False if the slot was a duplicate or late and was dropped.
+    */
+    bool insertSlotSequenced(const byte* ptrToSlot, const SlotMetadata& metadata);
+    
+    /*!
+     Sets the engine that fills the missing slots of a sequence-numbered stream.
+     By default, they're filled by setUnderrunReadSlot.
+     
+     With an engine, an under-run of readSlotNonBlocking is concealed too, as the
+     next slot being late: it isn't consumed, so it's still played if it arrives
+     before the next read, and the RingBuffer isn't cleared.
+     
+     The RingBuffer keeps the last \b HistorySlots read slots, oldest first, as the
+     engine input. The RingBuffer doesn't take ownership of the engine.
+     @param Engine Concealment engine or NULL for the default behavior.
+     @param HistorySlots Number of last read slots kept for the engine, at least 1.
+    */
+    void setConcealmentEngine(MTConcealmentEngine* Engine, int HistorySlots);
+    
+    /*!
+     Enables XOR parity recovery for sequence-numbered streams, with one parity
+     slot per group of \b GroupSize data slots.
+     
+     Parity slots aren't stored in the ring: they'd take the place of data slots and
+     shift the sequence arithmetic of every slot. They're kept in a buffer of their
+     own, alongside the ring, with one slot per group the ring can hold plus two.
+     
+     Groups start at sequence numbers that are multiples of GroupSize. When exactly
+     one data slot of a group is missing at playout time and the parity slot of the
+     group and all its other data slots are still held, the missing slot is rebuilt
+     in place before falling back to the concealment engine.
+     @param GroupSize Number of data slots protected by one parity slot, at least 2.
+    */
+    void setParityGroupSize(int GroupSize);
+    
+    /*!
+     Insert the parity slot of a group of data slots. This method never blocks.
+     @param ptrToSlot Pointer to the XOR of the GroupSize data slots of the group.
+     @param firstSequence Sequence number of the first data slot in the group.
+    */
+    void insertParitySlot(const byte* ptrToSlot, quint32 firstSequence);
+    
+    /*!
+     Enables the history mode, where read slots stay readable by sequence number
+     with readSlotBySequence until a write reuses their space. In this mode an
+     under-run doesn't clear the RingBuffer.
+     @param Enabled True to keep the read slots readable.
+    */
+    void setHistoryMode(bool Enabled);
+    
+    /*!
+     Copy the slot with the given sequence number into ptrToReadSlot, e.g. to serve a
+     retransmission. The slot is located by index arithmetic and isn't consumed.
+     
+     Sequence numbers are the ones given to insertSlotSequenced or, for the other
+     inserts, consecutive numbers that start after the NumSlots / 2 zero slots the
+     RingBuffer is created with: the first insert is NumSlots / 2. Read the number
+     of a slot from SlotMetadata::sequence rather than counting the inserts.
+     
+     Slots that were never inserted, i.e. those zero slots and the slots cleared by
+     an under-run, carry SlotFlagEmpty and aren't readable by sequence.
+     @param sequence Sequence number of the slot.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @return False if the slot wasn't inserted or isn't in the RingBuffer anymore.
+    */
+    bool readSlotBySequence(quint32 sequence, byte* ptrToReadSlot);
+    
+    /*! Returns the number of duplicate slots dropped by insertSlotSequenced. */
+    quint64 droppedDuplicateSlots();
+    
+    /*! Returns the number of late slots dropped by insertSlotSequenced. */
+    quint64 droppedLateSlots();
+    
+    /*!
+     Limits the rate readSlotBlocking releases slots at with a token bucket. Readers
+     sleep just long enough to keep every slot within the rate, to the nanosecond
+     with a precise timer, instead of draining the RingBuffer as fast as possible.
+     Pass 0 as BitsPerSecond to disable it.
+     @param BitsPerSecond Rate in bits per second, every slot costs SlotSize * 8 bits.
+     @param BurstSlots Number of slots that can be read back to back, at least 1.
+    */
+    void setReadRateLimit(qint64 BitsPerSecond, int BurstSlots);
+    
+    /*!
+     Splits the RingBuffer into \b NumLanes priority lanes, lane 0 being the highest
+     priority. Each lane has its own capacity and the RingBuffer is emptied.
+     
+     Readers always take the oldest slot of the highest priority lane that isn't
+     empty. Writers block on (or overflow) their own lane only, while the number
+     of full slots stays the sum of all the lanes. insertSlotBlocking and
+     insertSlotNonBlocking without a lane write to the lowest priority lane.
+     Windows, the delay line, sequenced inserts and reads by sequence address the
+     slots by position and throw std::logic_error once there are lanes.
+     @param LaneSlots Number of slots of every lane, at least 1 each and at most
+     NumSlots in total.
+     @param NumLanes Number of lanes.
+    */
+    void setPriorityLanes(const int* LaneSlots, int NumLanes);
+    
+    /*!
+     Same as insertSlotBlocking but into a priority lane.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param lane Priority lane, 0 being the highest priority.
+    */
+    void insertSlotBlocking(const byte* ptrToSlot, int lane);
+    
+    /*!
+     Same as insertSlotNonBlocking but into a priority lane.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param lane Priority lane, 0 being the highest priority.
+    */
+    void insertSlotNonBlocking(const byte* ptrToSlot, int lane);
+    
+    /*!
+     Insert a slot that conflates with the other slots with the same key, e.g. for
+     state updates where only the newest value per key matters. This method never
+     blocks.
+     
+     If a slot with the same key is still waiting to be read, it's overwritten in
+     place, keeping its position, so readers see at most one slot per key and
+     always its newest value. Otherwise, it's inserted like insertSlotNonBlocking.
+     Lookups are O(1) through a hash of the pending keys. Not available with
+     priority lanes.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param key Conflation key of the slot.
+    */
+    void insertSlotConflated(const byte* ptrToSlot, quint64 key);
+    
+    /*!
+     Publish a slot for the readers that only want the newest one, like meters.
+     This method is lock-free and wait-free, it never blocks nor takes the mutex.
+     
+     The latest mode is a triple buffer over the first three slots of the
+     RingBuffer, for one writer and one reader. Don't mix it with the other
+     inserts and reads on the same RingBuffer, it needs at least three slots.
+     @param ptrToSlot Pointer to slot to publish.
+    */
+    void publishLatestSlot(const byte* ptrToSlot);
+    
+    /*!
+     Read the newest completely published slot into ptrToReadSlot. This method is
+     lock-free and wait-free. If nothing was published since the last call, the
+     same slot is read again.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @return True if the slot is newer than the one of the last call.
+    */
+    bool readLatestSlot(byte* ptrToReadSlot);
+    
+    /*!
+     Copy the \b numSlots most recently written slots into dest, oldest first,
+     without consuming them and without taking the mutex, e.g. to draw a waveform.
+     
+     Every slot is copied with an optimistic read validated by its write sequence
+     (a seqlock), and copied again if a writer touched it during the copy. The
+     producer and the consumer are never slowed down. A slot still being written
+     after MonitorRetries attempts, e.g. a reserved slot or the open slot of
+     coalescing, is skipped and filled with zeros instead of waiting for it.
+     @param dest Destination of numSlots * SlotSize bytes.
+     @param numSlots Number of slots to copy, at most NumSlots.
+     @return Number of slots skipped.
+    */
+    int copyRecentSlots(byte* dest, int numSlots);
+    
+    /*!
+     Same as copyRecentSlots but for any range of slots of the RingBuffer.
+     @param firstSlot Index of the first slot, it wraps around the end.
+     @param numSlots Number of slots to copy, at most NumSlots.
+     @param dest Destination of numSlots * SlotSize bytes.
+     @return Number of slots skipped.
+    */
+    int copySlots(int firstSlot, int numSlots, byte* dest);
+    
+    /*!
+     Views of the slots waiting to be read, in place in the RingBuffer, so they
+     can be processed without copying. The region wraps around the end of the
+     RingBuffer, so it's split in up to two views of whole slots; second is empty
+     when it doesn't wrap. The views stay valid until consume releases the slots.
+     
+     Only one reader can use the views, and gaps, concealment and the read modes
+     are bypassed. Not available with priority lanes.
+     @param first Oldest slots.
+     @param second Slots after the wrap, or empty.
+     @return Number of slots in both views.
+    */
+    int getReadableRegion(MTSpan<const byte>& first, MTSpan<const byte>& second);
+    
+    /*!
+     Releases the oldest slots after they were processed through getReadableRegion.
+     @param numSlots Number of slots to release, at most the number of full slots.
+    */
+    void consume(int numSlots);
+    
+    /*!
+     Views of the free slots, in place in the RingBuffer, so they can be filled
+     without a staging copy, e.g. by a socket read. Same layout as
+     getReadableRegion. The views stay valid until produce publishes the slots.
+     
+     Only one writer can use the views. Monitors copying a slot while it's
+     written through a view may see it torn. Not available with priority lanes.
+     @param first Next slots to write.
+     @param second Slots after the wrap, or empty.
+     @return Number of slots in both views.
+    */
+    int getWritableRegion(MTSpan<byte>& first, MTSpan<byte>& second);
+    
+    /*!
+     Publishes the next slots after they were filled through getWritableRegion.
+     @param numSlots Number of slots to publish, at most the number of free slots.
+    */
+    void produce(int numSlots);
+    
+    /*!
+     Reserves the next slot for one of several producers, so it can be filled in
+     place outside of any lock and committed with commitSlot. If the RingBuffer is
+     full, it waits for the bufferIsNotFull condition.
+     
+     Slots are published to the reader in reservation order: a committed slot
+     becomes readable once all the slots reserved before it are committed as well.
+     While reservations are pending, the other inserts and readSlotNonBlocking
+     must not be used. Not available with priority lanes.
+     @return Pointer to the reserved slot, SlotSize bytes.
+    */
+    byte* reserveSlot();
+    
+    /*!
+     Commits a slot filled after reserveSlot and publishes the committed slots
+     that are next in reservation order.
+     @param ptrToSlot Pointer returned by reserveSlot.
+    */
+    void commitSlot(byte* ptrToSlot);
+    
 protected:
     /*!
      Sets the memory in the Read Slot when uderrun occurs. By default,
@@ -79,28 +689,312 @@ protected:
     virtual void setUnderrunReadSlot(byte* ptrToReadSlot);
     
 private:
+    /*! Flag of mLatestState set when the shared slot holds an unread publication. */
+    static const int LatestFresh = 0x4;
+    
+    /*! Attempts of copySlots at a slot being written before skipping it. */
+    static const int MonitorRetries = 64;
+    
+    /*! Priority lane, a contiguous range of slots used as a RingBuffer of its own. */
+    struct Lane {
+        int firstSlot;  // First slot of the lane in the RingBuffer
+        int numSlots;   // Number of slots of the lane
+        int readSlot;   // Read position in the lane, in slots
+        int fullSlots;  // Number of used (full) slots of the lane
+    };
+    
     /*! Resets the ring buffer for reads under-runs non-blocking. */
     void underrunReset();
     
     /*! Resets the ring buffer for writes over-flows non-blocking. */
     void overflowReset();
     
+    /*!
+     Copies one slot into the RingBuffer, keeping the window mirror up to date.
+     @param position Position of the slot in the RingBuffer in bytes.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param sequence Sequence number of the slot.
+    */
+    void copySlotIn(int position, const byte* ptrToSlot, quint32 sequence);
+    
+    /*!
+     Same as copySlotIn, gathering the slot from several buffers.
+     @param position Position of the slot in the RingBuffer in bytes.
+     @param vector Buffers to gather, in order.
+     @param count Number of buffers.
+     @param sequence Sequence number of the slot.
+     @return Number of bytes gathered.
+    */
+    int copySlotInV(int position, const struct iovec* vector, int count, quint32 sequence);
+    
+    /*!
+     Copies a slot into several buffers.
+     @param ptrToSlot Pointer to the slot.
+     @param length Number of bytes of the slot to copy.
+     @param vector Buffers to fill, in order.
+     @param count Number of buffers.
+     @return Number of bytes copied.
+    */
+    static int scatterSlot(const byte* ptrToSlot, int length, const struct iovec* vector, int count);
+    
+    /*! Publishes the open slot of the coalescing mode. */
+    void publishOpenSlot();
+    
+    /*! Publishes the open slot of the coalescing mode if its flush deadline passed. */
+    void publishDueSlot();
+    
+    /*!
+     Same as insertSlotBlocking with metadata, also setting RingBuffer tags on the
+     slot under the same lock.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param metadata Length, caller flags and timestamp of the slot.
+     @param tags SlotFlag tags under SlotFlagUser to set.
+     @param numbered True if metadata.sequence is the caller's number for the slot.
+    */
+    void insertTaggedSlotBlocking(const byte* ptrToSlot, const SlotMetadata& metadata, quint32 tags,
+                                  bool numbered);
+    
+    /*!
+     Same as insertSlotNonBlocking with metadata.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param metadata Length, caller flags and timestamp of the slot.
+     @param numbered True if metadata.sequence is the caller's number for the slot.
+    */
+    void insertSlotNonBlocking(const byte* ptrToSlot, const SlotMetadata& metadata, bool numbered);
+    
+    /*!
+     Returns the sequence number of the next slot inserted. In history mode, a
+     caller's number is followed by numbering the slots again if it isn't the next.
+     @param metadata Metadata of the slot.
+     @param numbered True if metadata.sequence is the caller's number for the slot.
+    */
+    quint32 insertSequence(const SlotMetadata& metadata, bool numbered);
+    
+    /*!
+     Numbers the slots again from the read position. The free slots only hold slots
+     of the previous numbering, they become unreadable by sequence.
+     @param readSequence Sequence number of the slot at the read position.
+    */
+    void renumberSlots(quint32 readSequence);
+    
+    /*!
+     Copies a group of slots in after the full slots, the space has to be free.
+     @param ptrToSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots in the group.
+    */
+    void insertGroup(const byte* ptrToSlots, int numSlots);
+    
+    /*!
+     Copies a group of full slots out and releases them.
+     @param ptrToReadSlots Pointer to numSlots * SlotSize bytes.
+     @param numSlots Number of slots in the group, at most the number of full slots.
+    */
+    void readGroup(byte* ptrToReadSlots, int numSlots);
+    
+    /*!
+     Releases the full slots in front of the next complete group.
+     @param maxSlots Largest group the caller can read, a larger one throws.
+     @return Number of slots of the group at the read position, 0 if there's none.
+    */
+    int skipToGroup(int maxSlots);
+    
+    /*!
+     Makes space for one slot without waiting, the way insertSlotNonBlocking does:
+     skips silence, drops the oldest slot on a delay line, or resets the
+     RingBuffer on an over-flow.
+     @return False if the RingBuffer was reset and the slot has to be dropped.
+    */
+    bool makeRoomNonBlocking();
+    
+    /*!
+     Waits until slots can be written, dropping the oldest ones on a delay line.
+     @param numSlots Number of slots to write, at most NumSlots.
+    */
+    void waitForFreeSlots(int numSlots);
+    
+    /*!
+     Waits until slots can be read and the read rate limit allows it.
+     @param numSlots Number of slots to read, at most NumSlots.
+    */
+    void waitForFullSlots(int numSlots);
+    
+    /*!
+     Marks a slot as being written for the monitor readers, until finishSlotWrite.
+     @param position Position of the slot in the RingBuffer in bytes.
+    */
+    void beginSlotWrite(int position);
+    
+    /*!
+     Moves the write position and publishes it for the monitor readers.
+     @param position New write position in bytes.
+    */
+    void setWritePosition(int position);
+    
+    /*!
+     Updates the tags and the window mirror of a slot written in the RingBuffer.
+     @param position Position of the slot in the RingBuffer in bytes.
+     @param sequence Sequence number of the slot.
+    */
+    void finishSlotWrite(int position, quint32 sequence);
+    
+    /*!
+     Rebuilds the slot at the read position from its parity group.
+     @return True if the slot was recovered.
+    */
+    bool recoverSlot();
+    
+    /*!
+     Copies the slot at the read position out, or conceals it if it's missing,
+     and saves it in the history. It doesn't move the read position.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @param metadata Metadata of the slot read, or NULL.
+    */
+    void copySlotOut(byte* ptrToReadSlot, SlotMetadata* metadata);
+    
+    /*!
+     Stores the caller part of the metadata of a slot.
+     @param slot Index of the slot.
+     @param metadata Length, caller flags and timestamp of the slot.
+    */
+    void setSlotMetadata(int slot, const SlotMetadata& metadata);
+    
+    /*!
+     Reads the metadata of a slot.
+     @param slot Index of the slot.
+     @param metadata Destination of the metadata, or NULL.
+    */
+    void getSlotMetadata(int slot, SlotMetadata* metadata) const;
+    
+    /*!
+     Appends a slot to the history of last read slots.
+     @param ptrToSlot Pointer to the slot that was read.
+    */
+    void saveLastReadSlot(const byte* ptrToSlot);
+    
+    /*!
+     Moves the read position forward, giving the slots back to the writers.
+     @param numSlots Number of slots, at most mFullSlots.
+    */
+    void advanceReadPosition(int numSlots);
+    
+    /*!
+     Compresses the next two slots into ptrToReadSlot and consumes both of them.
+     Both slots have to be the ones expected, not holes.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+    */
+    void readCompressedSlot(byte* ptrToReadSlot);
+    
+    /*!
+     Measures the level of a slot for silence skipping.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @return Silence or comfort noise flags for the slot.
+    */
+    quint32 classifySlot(const byte* ptrToSlot) const;
+    
+    /*!
+     Inserts a slot into a priority lane.
+     @param ptrToSlot Pointer to slot to insert into the RingBuffer.
+     @param lane Priority lane.
+     @param blocking True to wait for space, false to reset the lane when it's full.
+     @return Index of the slot written or -1 if the lane overflowed.
+    */
+    int insertLaneSlot(const byte* ptrToSlot, int lane, bool blocking);
+    
+    /*!
+     Reads the oldest slot of the highest priority lane that isn't empty.
+     @param ptrToReadSlot Pointer to read slot from the RingBuffer.
+     @param metadata Metadata of the slot read, or NULL.
+    */
+    void readLaneSlot(byte* ptrToReadSlot, SlotMetadata* metadata);
+    
+    /*!
+     Takes the tokens for some slots from the read rate limit bucket.
+     @param numSlots Number of slots to read.
+     @param waited True if the reader already slept for these tokens.
+     @return 0 if the slots can be read, otherwise the time to wait in nanoseconds.
+    */
+    qint64 takeReadTokens(int numSlots, bool waited);
+    
+    /*! Drops the tagged slots at the read position while above the target fill level. */
+    void skipSilentSlots();
+    
+    /*! Drops the oldest slot to make space for a write in delay line mode. */
+    void dropOldestSlot();
+    
+    /*! Returns true when a complete window is available to read. */
+    bool isWindowAvailable() const;
+    
     /*! Helper method to debug, prints member variables to terminal. */
     void debugDump() const;
     
     const int mSlotSize;   // The size of one slot in byes
     const int mNumSlots;   // Number of Slots
     const int mTotalSize;  // Total size of the mRingBuffer = mSlotSize*mNumSlotss
+    const int mMirrorSize; // Size allocated past mTotalSize for the window mirror
     int mReadPosition;     // Read Positions in the RingBuffer (Tail)
     int mWritePosition;    // Write Position in the RingBuffer (Head)
     int mFullSlots;        // Number of used (full) slots, in slot-size
+    int mReservedSlots;    // Number of slots reserved after the full slots
     byte* mRingBuffer;     // 8-bit array of data (1-byte)
-    byte* mLastReadSlot;   // Last slot read
+    byte* mLastReadSlot;   // History of the last read slots, oldest first
+    int mHistorySlots;     // Number of slots in mLastReadSlot
+    quint32* mSlotFlags;   // SlotFlag tags of every slot
+    quint32* mSlotSequence;// Sequence number of every slot
+    int* mSlotLength;      // Number of bytes used in every slot
+    qint64* mSlotTimestamp;// Caller timestamp of every slot
+    int* mSlotGroupSize;   // Number of slots of the group starting at every SlotFlagGroup slot
+    quint32 mReadSequence; // Sequence number expected at mReadPosition
+    bool mSequenced;       // True once slots are inserted by sequence number
+    MTConcealmentEngine* mConcealment; // Fills missing slots (NULL for setUnderrunReadSlot)
+    int mLostSlots;        // Number of consecutive missing slots read
+    int mParityGroupSize;  // Number of data slots per parity slot (0 if disabled)
+    int mNumParitySlots;   // Number of parity slots kept
+    byte* mParitySlots;    // Parity slots of the groups in the RingBuffer, outside the ring
+    quint32* mParitySequence; // First sequence number of the group of every parity slot
+    bool mHistoryMode;     // True when read slots stay readable by sequence number
+    quint64* mReceivedSlots;  // Bitmap of the slots written since the read position last passed them
+    quint64 mDuplicateSlots;  // Number of duplicate slots dropped
+    quint64 mLateSlots;       // Number of late slots dropped
+    qint64 mReadRate;         // Read rate limit in bits per second (0 if disabled)
+    double mReadTokens;       // Bits that can be read right now
+    double mReadBurst;        // Maximum number of bits in the bucket
+    qint64 mLastRefill;       // Time of the last bucket refill in nanoseconds of mRateClock
+    QElapsedTimer mRateClock; // Monotonic clock of the read rate limit
+    std::vector<Lane> mLanes; // Priority lanes (empty if disabled)
+    quint64* mSlotKey;        // Conflation key of every slot tagged SlotFlagKeyed
+    QHash<quint64, int> mPendingKeys; // Slot of every conflation key waiting to be read
+    QAtomicInt mLatestState;  // Slot shared by the latest mode writer and reader, plus LatestFresh
+    int mLatestWriteSlot;     // Slot owned by the latest mode writer
+    int mLatestReadSlot;      // Slot owned by the latest mode reader
+    QAtomicInt* mSlotVersion; // Write sequence of every slot, odd while the slot is being written
+    QAtomicInt mMonitorWriteSlot; // Write position in slots, published for the monitor readers
+    
+    QAtomicInt* mSlotReferences;  // Consumers that haven't released every slot yet, in shared mode
+    std::vector<int> mConsumerSlots; // Full slots already read by every consumer (empty if disabled)
+    
+    qint64 mCoalesceDelay;        // Longest time a message waits in the open slot in nanoseconds (0 if disabled)
+    int mOpenSlotUsed;            // Bytes used in the open slot at the write position (-1 if none)
+    qint64 mOpenSlotDeadline;     // Time to publish the open slot in nanoseconds of mCoalesceClock
+    QElapsedTimer mCoalesceClock; // Monotonic clock of the coalescing mode
+    int mWindowSize;       // Size of a windowed read in bytes, also the size of the mirror (0 if disabled)
+    int mHopSize;          // Number of bytes a window advances
+    int mWindowOffset;     // Offset of the window inside the slot at mReadPosition
+    bool mDelayLine;       // True when the RingBuffer runs as a fixed delay line
+    int mDelayInteger;     // Integer part of the delay in samples
+    float mDelayFraction;  // Fractional part of the delay in samples
+    int mRecoveryThreshold;     // Fill level in slots above which latency is recovered (0 if disabled)
+    int mRecoveryOverlap;       // Cross-fade length of a compressed slot in samples
+    int mRecoveryInterval;      // Number of reads per compressed slot
+    int mReadsSinceRecovery;    // Reads since the last compressed slot
+    float mSilenceLevel;        // Mean square level under which a slot is silence
+    float mComfortNoiseLevel;   // Mean square level under which a slot is comfort noise
+    int mSilenceTarget;         // Fill level in slots to skip silence down to (0 if disabled)
     
     // Thread Synchronization Private Members
     QMutex mMutex;                    // Mutex to protect read and write operations
     QWaitCondition mBufferIsNotFull;  // Buffer not full condition to monitor threads
     QWaitCondition mBufferIsNotEmpty; // Buffer not empty condition to monitor threads
+    QWaitCondition mReadRateChanged;  // Wakes readers waiting for read tokens
 };
 
 #endif /* MTRingBuffer_hpp */
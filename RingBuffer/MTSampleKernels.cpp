@@ -0,0 +1,124 @@
+//
+//  MTSampleKernels.cpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#include <cstring>
+
+#include "MTSampleKernels.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MT_SAMPLE_KERNELS_SSE 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MT_SAMPLE_KERNELS_SSE2 1
+#endif
+
+//******************************************************************************
+void MTSampleKernels::interpolate(const float* newer, const float* older, float fraction,
+                                  float* out, int count) {
+    int i = 0;
+#ifdef MT_SAMPLE_KERNELS_SSE
+    const __m128 vFraction = _mm_set1_ps(fraction);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 vNewer = _mm_loadu_ps(newer + i);
+        const __m128 vOlder = _mm_loadu_ps(older + i);
+        const __m128 vDelta = _mm_mul_ps(_mm_sub_ps(vOlder, vNewer), vFraction);
+        _mm_storeu_ps(out + i, _mm_add_ps(vNewer, vDelta));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = newer[i] + fraction * (older[i] - newer[i]);
+    }
+}
+
+//******************************************************************************
+float MTSampleKernels::dot(const float* a, const float* b, int count) {
+    int i = 0;
+    float sum = 0.0f;
+#ifdef MT_SAMPLE_KERNELS_SSE
+    __m128 vSum = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        vSum = _mm_add_ps(vSum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vSum);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+//******************************************************************************
+void MTSampleKernels::crossfade(const float* from, const float* to, float* out, int count) {
+    if (count == 1) {
+        out[0] = to[0];
+        return;
+    }
+    const float step = 1.0f / static_cast<float>(count - 1);
+    int i = 0;
+#ifdef MT_SAMPLE_KERNELS_SSE
+    const __m128 vStep = _mm_set1_ps(4.0f * step);
+    __m128 vGain = _mm_setr_ps(0.0f, step, 2.0f * step, 3.0f * step);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 vFrom = _mm_loadu_ps(from + i);
+        const __m128 vDelta = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(to + i), vFrom), vGain);
+        _mm_storeu_ps(out + i, _mm_add_ps(vFrom, vDelta));
+        vGain = _mm_add_ps(vGain, vStep);
+    }
+#endif
+    for (; i < count; i++) {
+        const float gain = static_cast<float>(i) * step;
+        out[i] = from[i] + gain * (to[i] - from[i]);
+    }
+}
+
+//******************************************************************************
+void MTSampleKernels::ramp(float* samples, float startGain, float endGain, int count) {
+    const float step = (endGain - startGain) / static_cast<float>(count);
+    int i = 0;
+#ifdef MT_SAMPLE_KERNELS_SSE
+    const __m128 vStep = _mm_set1_ps(4.0f * step);
+    __m128 vGain = _mm_setr_ps(startGain, startGain + step, startGain + 2.0f * step,
+                               startGain + 3.0f * step);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), vGain));
+        vGain = _mm_add_ps(vGain, vStep);
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] *= startGain + static_cast<float>(i) * step;
+    }
+}
+
+//******************************************************************************
+void MTSampleKernels::xorBytes(byte* dest, const byte* src, int count) {
+    int i = 0;
+#ifdef MT_SAMPLE_KERNELS_SSE2
+    for (; i + 16 <= count; i += 16) {
+        const __m128i vDest = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        const __m128i vSrc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(vDest, vSrc));
+    }
+#endif
+    // Whole words, memcpy keeps the unaligned accesses legal
+    for (; i + 8 <= count; i += 8) {
+        quint64 destWord;
+        quint64 srcWord;
+        std::memcpy(&destWord, dest + i, sizeof(destWord));
+        std::memcpy(&srcWord, src + i, sizeof(srcWord));
+        destWord ^= srcWord;
+        std::memcpy(dest + i, &destWord, sizeof(destWord));
+    }
+    for (; i < count; i++) {
+        dest[i] ^= src[i];
+    }
+}
@@ -0,0 +1,74 @@
+//
+//  MTSampleKernels.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTSampleKernels_hpp
+#define MTSampleKernels_hpp
+
+#include "MTAudioControllerGlobals.h"
+
+/*!
+ Vectorized kernels over 32-bit float samples used by the RingBuffer modes
+ that process audio in place.
+ 
+ The kernels use SSE when the target supports it. Otherwise they fall back to
+ plain loops written so the compiler can auto-vectorize them (e.g. NEON).
+ Pointers don't need to be aligned.
+*/
+class MTSampleKernels {
+public:
+    /*!
+     Linear interpolation between two taps of a delay line,
+     out[i] = newer[i] + fraction * (older[i] - newer[i]).
+     @param newer Samples at the integer part of the delay.
+     @param older Samples one sample further in the past.
+     @param fraction Fractional part of the delay, in [0, 1).
+     @param out Interpolated samples.
+     @param count Number of samples.
+    */
+    static void interpolate(const float* newer, const float* older, float fraction,
+                            float* out, int count);
+    
+    /*!
+     Dot product of two runs of samples.
+     @param a First run of samples.
+     @param b Second run of samples.
+     @param count Number of samples.
+     @return Sum of a[i] * b[i].
+    */
+    static float dot(const float* a, const float* b, int count);
+    
+    /*!
+     Linear cross-fade from one run of samples into another, the first output
+     sample is from[0] and the last one is to[count - 1].
+     @param from Samples faded out.
+     @param to Samples faded in.
+     @param out Cross-faded samples.
+     @param count Number of samples.
+    */
+    static void crossfade(const float* from, const float* to, float* out, int count);
+    
+    /*!
+     Applies a linear gain ramp in place, the first sample is scaled by
+     startGain and the gain moves towards endGain by (endGain - startGain) / count.
+     @param samples Samples to scale.
+     @param startGain Gain of the first sample.
+     @param endGain Gain the ramp is heading to after the last sample.
+     @param count Number of samples.
+    */
+    static void ramp(float* samples, float startGain, float endGain, int count);
+    
+    /*!
+     XORs a block of bytes into another one, dest[i] ^= src[i].
+     @param dest Bytes to update.
+     @param src Bytes to XOR in.
+     @param count Number of bytes.
+    */
+    static void xorBytes(byte* dest, const byte* src, int count);
+};
+
+#endif /* MTSampleKernels_hpp */
@@ -0,0 +1,52 @@
+//
+//  MTSpan.hpp
+//  MTAudioController
+//
+//  Created by agent on 18.10.26.
+//  Copyright © 2026 Zeus Group LLP. All rights reserved.
+//
+
+#ifndef MTSpan_hpp
+#define MTSpan_hpp
+
+#include <cstddef>
+
+/*!
+ Non-owning view of a contiguous run of elements, the subset of std::span the
+ RingBuffer needs without requiring C++20. It has begin() and end(), so it works
+ with the standard algorithms and range-based for loops.
+*/
+template <typename T>
+class MTSpan {
+public:
+    /*! Empty span. */
+    MTSpan() : mData(NULL), mSize(0) {}
+
+    /*!
+     @param Data Pointer to the first element.
+     @param Size Number of elements.
+    */
+    MTSpan(T* Data, std::size_t Size) : mData(Data), mSize(Size) {}
+
+    T* data() const { return mData; }
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    T* begin() const { return mData; }
+    T* end() const { return mData + mSize; }
+
+    T& operator[](std::size_t index) const { return mData[index]; }
+
+    /*!
+     @param offset Index of the first element of the view.
+     @param count Number of elements of the view.
+     @return View of count elements starting at offset.
+    */
+    MTSpan subspan(std::size_t offset, std::size_t count) const { return MTSpan(mData + offset, count); }
+
+private:
+    T* mData;           // First element
+    std::size_t mSize;  // Number of elements
+};
+
+#endif /* MTSpan_hpp */